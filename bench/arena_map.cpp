@@ -0,0 +1,59 @@
+#include "bench.h"
+#include "../include/arena.h"
+#include "../include/map.h"
+#include "../include/list.h"
+#include "../include/vector.h"
+
+typedef std::pair<const int, int> Entry;
+typedef RBTreeNode<Entry> Node;
+
+template <typename MAP>
+long fill(MAP& map, int entry_nr){
+    for(int i = 0; i < entry_nr; i++) map[(i * 7919) % entry_nr] = i;
+    return map.size();
+}
+
+int main(){
+    const int entry_nr = 10000;
+    const int round_nr = 300;
+    long sink = 0;
+
+    Timer timer;
+    for(int r = 0; r < round_nr; r++){
+        Map<int, int> map;
+        sink += fill(map, entry_nr);
+    }
+    double new_ns = timer.nanoseconds() / round_nr;
+
+    timer.reset();
+    for(int r = 0; r < round_nr; r++){
+        Map<int, int, std::less<int>, PollAllocator<Node>> map;
+        sink += fill(map, entry_nr);
+    }
+    double pool_ns = timer.nanoseconds() / round_nr;
+
+    timer.reset();
+    for(int r = 0; r < round_nr; r++){
+        MonotonicArena arena;
+        Map<int, int, std::less<int>, ArenaAllocator<Node>> map{ArenaAllocator<Node>(&arena)};
+        sink += fill(map, entry_nr);
+    }
+    double arena_ns = timer.nanoseconds() / round_nr;
+
+    timer.reset();
+    static char buffer[entry_nr * sizeof(Node)];
+    for(int r = 0; r < round_nr; r++){
+        MonotonicArena arena(buffer, sizeof(buffer));
+        Map<int, int, std::less<int>, ArenaAllocator<Node>> map{ArenaAllocator<Node>(&arena)};
+        sink += fill(map, entry_nr);
+    }
+    double buffer_ns = timer.nanoseconds() / round_nr;
+    do_not_optimize(sink);
+
+    std::printf("build + destroy Map of %d entries\n", entry_nr);
+    std::printf("%-28s %10.1f us\n", "NewAllocator", new_ns / 1000);
+    std::printf("%-28s %10.1f us\n", "PollAllocator", pool_ns / 1000);
+    std::printf("%-28s %10.1f us\n", "MonotonicArena", arena_ns / 1000);
+    std::printf("%-28s %10.1f us\n", "MonotonicArena + buffer", buffer_ns / 1000);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include "bench.h"
+#include "../include/map.h"
+#include "../include/list.h"
+#include "../include/vector.h"
+
+// Counts allocator calls made through either interface.
+template <typename BASE>
+struct CountingAllocator: BASE{
+    typedef typename AllocatorTraits<BASE>::value_type value_type;
+    static size_t calls;
+    static value_type* allocate(size_t obj_nr, void* = nullptr){ calls++; return BASE::allocate(obj_nr);}
+    static void deallocate(value_type* p, size_t obj_nr){ calls++; BASE::deallocate(p, obj_nr);}
+    static value_type* allocate_batch(size_t obj_nr){ calls++; return BASE::allocate_batch(obj_nr);}
+    static void deallocate_batch(value_type* first, value_type* last, size_t obj_nr){ calls++; BASE::deallocate_batch(first, last, obj_nr);}
+};
+template <typename BASE>
+size_t CountingAllocator<BASE>::calls = 0;
+
+template <typename ALLOC>
+void map_copy(const char* name, size_t node_nr){
+    Map<long, long, std::less<long>, ALLOC> map;
+    for(size_t i = 0; i < node_nr; i++) map[(i * 2654435761u) % node_nr] = i;
+    ALLOC::calls = 0;
+    Timer timer;
+    {
+        Map<long, long, std::less<long>, ALLOC> copy(map);
+        do_not_optimize(copy.size());
+    }
+    std::printf("%-36s %8.1f ms %10zu container->allocator calls\n", name, timer.seconds() * 1000, ALLOC::calls);
+}
+
+template <typename ALLOC>
+void list_range(const char* name, const Vector<long>& src){
+    ALLOC::calls = 0;
+    Timer timer;
+    {
+        List<long, ALLOC> list;
+        list.insert(list.end(), src.begin(), src.end());
+        do_not_optimize(list.size());
+    }
+    std::printf("%-36s %8.1f ms %10zu container->allocator calls\n", name, timer.seconds() * 1000, ALLOC::calls);
+}
+
+int main(){
+    const size_t node_nr = 1000000;
+    typedef RBTreeNode<std::pair<const long, long>> MapNode;
+    map_copy<CountingAllocator<NewAllocator<MapNode>>>("Map copy + destroy, NewAllocator", node_nr);
+    map_copy<CountingAllocator<PollAllocator<MapNode>>>("Map copy + destroy, PollAllocator", node_nr);
+
+    Vector<long> src;
+    for(size_t i = 0; i < node_nr; i++) src.push_back(i);
+    list_range<CountingAllocator<NewAllocator<ListNode<long>>>>("List range build, NewAllocator", src);
+    list_range<CountingAllocator<PollAllocator<ListNode<long>>>>("List range build, PollAllocator", src);
+    return 0;
+}
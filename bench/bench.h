@@ -0,0 +1,28 @@
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include <chrono>
+#include <cstdio>
+
+class Timer{
+    public:
+        typedef std::chrono::steady_clock clock;
+
+        Timer():start_(clock::now()){}
+        void reset(){ start_ = clock::now();}
+        double seconds() const{
+            return std::chrono::duration<double>(clock::now() - start_).count();
+        }
+        double nanoseconds() const{
+            return std::chrono::duration<double, std::nano>(clock::now() - start_).count();
+        }
+    private:
+        clock::time_point start_;
+};
+
+template <typename T>
+inline void do_not_optimize(const T& value){
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+#endif
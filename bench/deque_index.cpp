@@ -0,0 +1,37 @@
+#include <random>
+#include "bench.h"
+#include "../include/vector.h"
+#include "../include/deque.h"
+
+// Sums elements at random positions through operator[].
+template <typename CONTAINER>
+void random_reads(const char* name, size_t elem_nr, Vector<unsigned>& positions){
+    CONTAINER c;
+    for(size_t i = 0; i < elem_nr; i++) c.push_back(int(i));
+    Timer timer;
+    long sum = 0;
+    for(size_t i = 0; i < positions.size(); i++) sum += c[positions[i]];
+    do_not_optimize(sum);
+    double random = timer.nanoseconds() / positions.size();
+    timer.reset();
+    sum = 0;
+    for(size_t i = 0; i < elem_nr; i++) sum += c[i];
+    do_not_optimize(sum);
+    double sequential = timer.nanoseconds() / elem_nr;
+    std::printf("%-32s random %6.2f ns/read  sequential %6.2f ns/read\n", name, random, sequential);
+}
+
+int main(){
+    const size_t elem_nr = 1 << 20;
+    const size_t read_nr = 20000000;
+    std::mt19937 rng(3);
+    Vector<unsigned> positions;
+    for(size_t i = 0; i < read_nr; i++) positions.push_back(rng() % elem_nr);
+
+    random_reads<Deque<int, NewAllocator, 64>>("Deque<int> 64-byte blocks", elem_nr, positions);
+    random_reads<Deque<int, NewAllocator, 512>>("Deque<int> 512-byte blocks", elem_nr, positions);
+    random_reads<Deque<int, NewAllocator, 4096>>("Deque<int> 4096-byte blocks", elem_nr, positions);
+    random_reads<Deque<int, NewAllocator, 65536>>("Deque<int> 65536-byte blocks", elem_nr, positions);
+    random_reads<Vector<int>>("Vector<int>", elem_nr, positions);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#include <random>
+#include <string>
+#include <deque>
+#include "bench.h"
+#include "../include/vector.h"
+#include "../include/deque.h"
+
+// Inserts strings at random positions, then erases at random positions
+// until the container is empty again.
+template <typename CONTAINER>
+void random_middle(const char* name, Vector<unsigned>& positions){
+    size_t op_nr = positions.size();
+    CONTAINER c;
+    Timer timer;
+    for(size_t i = 0; i < op_nr; i++){
+        c.insert(c.begin() + positions[i] % (c.size() + 1), std::string(24, char('a' + i % 26)));
+    }
+    double insert = timer.nanoseconds() / op_nr;
+    do_not_optimize(c.front());
+    timer.reset();
+    for(size_t i = 0; i < op_nr; i++) c.erase(c.begin() + positions[i] % c.size());
+    double erase = timer.nanoseconds() / op_nr;
+    std::printf("%-30s insert %8.1f ns/op  erase %8.1f ns/op\n", name, insert, erase);
+}
+
+int main(){
+    const size_t op_nr = 50000;
+    std::mt19937 rng(11);
+    Vector<unsigned> positions;
+    for(size_t i = 0; i < op_nr; i++) positions.push_back(rng());
+
+    random_middle<Deque<std::string>>("Deque<std::string>", positions);
+    random_middle<std::deque<std::string>>("std::deque<std::string>", positions);
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include <numeric>
+#include <algorithm>
+#include "bench.h"
+#include "../include/vector.h"
+#include "../include/deque.h"
+
+// Runs the same pass over a Deque<int> through DequeIterator and through the
+// block-at-a-time segmented version.
+template <typename PLAIN, typename SEGMENTED>
+void compare(const char* name, size_t elem_nr, int rounds, PLAIN plain, SEGMENTED segmented){
+    Timer timer;
+    for(int r = 0; r < rounds; r++) plain();
+    double iter = timer.nanoseconds() / (double(elem_nr) * rounds);
+    timer.reset();
+    for(int r = 0; r < rounds; r++) segmented();
+    double seg = timer.nanoseconds() / (double(elem_nr) * rounds);
+    std::printf("%-12s iterator %6.3f ns/elem  segmented %6.3f ns/elem  (%.1fx)\n", name, iter, seg, iter / seg);
+}
+
+int main(){
+    const size_t elem_nr = 1 << 22;
+    const int rounds = 20;
+    Deque<int> d;
+    for(size_t i = 0; i < elem_nr; i++) d.push_back(int(i & 1023));
+    Vector<int> out(elem_nr, 0);
+
+    compare("accumulate", elem_nr, rounds,
+        [&]{ do_not_optimize(std::accumulate(d.begin(), d.end(), 0L));},
+        [&]{ do_not_optimize(segmented_accumulate(d.begin(), d.end(), 0L));});
+    compare("find", elem_nr, rounds,
+        [&]{ do_not_optimize(*std::find(d.begin(), d.end() - 1, -1));},
+        [&]{ do_not_optimize(*segmented_find(d.begin(), d.end() - 1, -1));});
+    compare("fill", elem_nr, rounds,
+        [&]{ std::fill(d.begin(), d.end(), 7); do_not_optimize(d[elem_nr / 2]);},
+        [&]{ segmented_fill(d.begin(), d.end(), 7); do_not_optimize(d[elem_nr / 2]);});
+    compare("copy out", elem_nr, rounds,
+        [&]{ std::copy(d.begin(), d.end(), out.begin()); do_not_optimize(out[elem_nr / 2]);},
+        [&]{ segmented_copy(d.begin(), d.end(), out.begin()); do_not_optimize(out[elem_nr / 2]);});
+    compare("copy in", elem_nr, rounds,
+        [&]{ std::copy(out.begin(), out.end(), d.begin()); do_not_optimize(d[elem_nr / 2]);},
+        [&]{ segmented_copy(out.begin(), out.end(), d.begin()); do_not_optimize(d[elem_nr / 2]);});
+    compare("for_each", elem_nr, rounds,
+        [&]{ std::for_each(d.begin(), d.end(), [](int& x){ x += 1;}); do_not_optimize(d[elem_nr / 2]);},
+        [&]{ segmented_for_each(d.begin(), d.end(), [](int& x){ x += 1;}); do_not_optimize(d[elem_nr / 2]);});
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <random>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "../include/map.h"
+
+typedef Map<long, long, std::less<long>, PollAllocator<RBTreeNode<std::pair<const long, long>>>> PoolMap;
+
+// The pool is process-wide, so every chunk source is measured in a fresh child.
+void run(const char* name, size_t node_nr, size_t find_nr){
+    PoolMap map;
+    std::mt19937_64 rng(42);
+    std::vector<long> keys(node_nr);
+    for(size_t i = 0; i < node_nr; i++){
+        keys[i] = static_cast<long>(rng());
+        map[keys[i]] = i;
+    }
+    Timer timer;
+    long sum = 0;
+    for(size_t i = 0; i < find_nr; i++){
+        sum += map.find(keys[rng() % node_nr])->second;
+    }
+    do_not_optimize(sum);
+    std::printf("%-24s %10zu nodes %8.1f ns/find\n", name, node_nr, timer.nanoseconds() / find_nr);
+}
+
+template <typename SOURCE>
+void fork_run(const char* name, size_t node_nr, size_t find_nr, MmapChunkSource::HugePageMode mode = MmapChunkSource::HUGE_PAGE_NONE){
+    pid_t pid = fork();
+    if(pid == 0){
+        MmapChunkSource::set_huge_pages(mode);
+        PoolAllocatorBase::use_chunk_source<SOURCE>();
+        run(name, node_nr, find_nr);
+        std::fflush(stdout);
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+}
+
+int main(){
+    const size_t find_nr = 2000000;
+    for(size_t node_nr = 1 << 16; node_nr <= (1 << 22); node_nr <<= 2){
+        fork_run<NewChunkSource>("operator new", node_nr, find_nr);
+        fork_run<MmapChunkSource>("mmap", node_nr, find_nr);
+        fork_run<MmapChunkSource>("mmap + MADV_HUGEPAGE", node_nr, find_nr, MmapChunkSource::HUGE_PAGE_MADVISE);
+        fork_run<MmapChunkSource>("mmap + MAP_HUGETLB", node_nr, find_nr, MmapChunkSource::HUGE_PAGE_HUGETLB);
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include <cstdio>
+#include "bench.h"
+#include "../include/vector.h"
+#include "../include/mapped_vector.h"
+
+struct Entry{
+    long key;
+    long value;
+};
+
+// Compares rebuilding a lookup table at startup with reopening a mapped one.
+int main(){
+    const size_t elem_nr = 20000000;
+    const char* path = "/tmp/mapped_vector_bench.bin";
+    std::remove(path);
+
+    Timer timer;
+    {
+        Vector<Entry> table;
+        for(size_t i = 0; i < elem_nr; i++) table.push_back(Entry{long(i), long(i * 3)});
+        do_not_optimize(table.size());
+    }
+    std::printf("%-40s %8.1f ms\n", "Vector rebuild with push_back", timer.seconds() * 1000);
+
+    timer.reset();
+    {
+        MappedVector<Entry> table(path);
+        for(size_t i = 0; i < elem_nr; i++) table.push_back(Entry{long(i), long(i * 3)});
+        table.sync();
+    }
+    std::printf("%-40s %8.1f ms\n", "MappedVector build + sync", timer.seconds() * 1000);
+
+    timer.reset();
+    {
+        MappedVector<Entry> table(path);
+        do_not_optimize(table[elem_nr / 2].value);
+    }
+    std::printf("%-40s %8.3f ms\n", "MappedVector reopen + lookup", timer.seconds() * 1000);
+
+    std::remove(path);
+    return 0;
+}
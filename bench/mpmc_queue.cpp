@@ -0,0 +1,72 @@
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include "bench.h"
+#include "../include/queue.h"
+#include "../include/mpmc_queue.h"
+
+// Queue<long> behind one mutex, with the same push/pop surface.
+class LockedQueue{
+    public:
+        void push(long value){
+            std::lock_guard<std::mutex> guard(lock_);
+            q_.push(value);
+        }
+        void pop(long& value){
+            while(true){
+                {
+                    std::lock_guard<std::mutex> guard(lock_);
+                    if(!q_.empty()){
+                        value = q_.front();
+                        q_.pop();
+                        return;
+                    }
+                }
+                std::this_thread::yield();
+            }
+        }
+    private:
+        std::mutex lock_;
+        Queue<long, Deque<long>> q_;
+};
+
+inline long now_ns(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Timer::clock::now().time_since_epoch()).count();
+}
+
+// thread_nr producers and thread_nr consumers pass item_nr timestamps; the
+// consumers add up how long each one waited in the queue.
+template <typename QUEUE>
+void fan(const char* name, int thread_nr, long item_nr){
+    QUEUE* q = new QUEUE;
+    std::atomic<long> latency{0};
+    std::vector<std::thread> threads;
+    long per_thread = item_nr / thread_nr;
+    Timer timer;
+    for(int t = 0; t < thread_nr; t++){
+        threads.emplace_back([&]{ for(long i = 0; i < per_thread; i++) q->push(now_ns());});
+        threads.emplace_back([&]{
+            long sum = 0, stamp;
+            for(long i = 0; i < per_thread; i++){
+                q->pop(stamp);
+                sum += now_ns() - stamp;
+            }
+            latency += sum;
+        });
+    }
+    for(auto& t : threads) t.join();
+    double ns = timer.nanoseconds();
+    long done = per_thread * thread_nr;
+    std::printf("%-22s %2d+%-2d threads %8.1f ns/item %12.0f ns mean latency\n", name, thread_nr, thread_nr, ns / done, double(latency) / done);
+    delete q;
+}
+
+int main(){
+    const long item_nr = 1000000;
+    for(int thread_nr = 1; thread_nr <= 32; thread_nr *= 2){
+        fan<LockedQueue>("mutex + Queue<long>", thread_nr, item_nr);
+        fan<MpmcQueue<long, 1024>>("MpmcQueue<long, 1024>", thread_nr, item_nr);
+    }
+    return 0;
+}
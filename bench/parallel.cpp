@@ -0,0 +1,48 @@
+#include <random>
+#include "bench.h"
+#include "../include/vector.h"
+#include "../include/deque.h"
+#include "../include/parallel.h"
+
+template <typename CONTAINER>
+void algorithms(const char* name, size_t elem_nr){
+    std::mt19937_64 rng(1);
+    CONTAINER c;
+    for(size_t i = 0; i < elem_nr; i++) c.push_back(long(rng() % 1000000));
+    CONTAINER out(c);
+
+    Timer timer;
+    do_not_optimize(std::accumulate(c.begin(), c.end(), 0L));
+    double serial_reduce = timer.seconds(); timer.reset();
+    do_not_optimize(parallel_reduce(c.begin(), c.end(), 0L));
+    double reduce = timer.seconds(); timer.reset();
+    std::inclusive_scan(c.begin(), c.end(), out.begin());
+    double serial_scan = timer.seconds(); timer.reset();
+    parallel_inclusive_scan(c.begin(), c.end(), out.begin());
+    double scan = timer.seconds(); timer.reset();
+    std::transform(c.begin(), c.end(), out.begin(), [](long x){ return x * 3 + 1;});
+    double serial_transform = timer.seconds(); timer.reset();
+    parallel_transform(c.begin(), c.end(), out.begin(), [](long x){ return x * 3 + 1;});
+    double transform = timer.seconds();
+
+    out = c;
+    timer.reset();
+    std::sort(out.begin(), out.end());
+    double serial_sort = timer.seconds();
+    out = c;
+    timer.reset();
+    parallel_sort(out.begin(), out.end());
+    double sort = timer.seconds();
+
+    std::printf("%-14s serial/parallel ms: reduce %6.1f/%6.1f  scan %6.1f/%6.1f  transform %6.1f/%6.1f  sort %7.1f/%7.1f\n", name,
+                serial_reduce * 1000, reduce * 1000, serial_scan * 1000, scan * 1000,
+                serial_transform * 1000, transform * 1000, serial_sort * 1000, sort * 1000);
+}
+
+int main(){
+    const size_t elem_nr = 10000000;
+    std::printf("%zu threads\n", TaskScheduler::instance().thread_count());
+    algorithms<Vector<long>>("Vector<long>", elem_nr);
+    algorithms<Deque<long>>("Deque<long>", elem_nr);
+    return 0;
+}
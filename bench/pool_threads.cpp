@@ -0,0 +1,48 @@
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "../include/allocator.h"
+#include "../include/list.h"
+
+// Every thread keeps a window of live nodes and recycles them, which is the
+// pattern of a worker building and tearing down List/Map nodes.
+template <typename ALLOC>
+void worker(size_t ops){
+    typedef ListNode<long> Node;
+    enum{WINDOW = 256};
+    Node* live[WINDOW] = {};
+    for(size_t i = 0; i < ops; i++){
+        size_t slot = (i * 7919) % WINDOW;
+        if(live[slot] != nullptr) ALLOC::deallocate(live[slot], 1);
+        live[slot] = ALLOC::allocate(1);
+        live[slot]->data_ = i;
+    }
+    for(size_t i = 0; i < WINDOW; i++){
+        if(live[i] != nullptr) ALLOC::deallocate(live[i], 1);
+    }
+}
+
+template <typename ALLOC>
+double run(unsigned thread_nr, size_t ops_per_thread){
+    Timer timer;
+    std::vector<std::thread> threads;
+    for(unsigned i = 0; i < thread_nr; i++){
+        threads.emplace_back(worker<ALLOC>, ops_per_thread);
+    }
+    for(auto& t : threads) t.join();
+    return thread_nr * ops_per_thread / timer.seconds() / 1e6;
+}
+
+int main(){
+    const size_t ops = 4000000;
+    unsigned max_threads = std::thread::hardware_concurrency();
+    if(max_threads == 0) max_threads = 4;
+    std::printf("%8s %16s %16s\n", "threads", "NewAllocator", "PollAllocator");
+    for(unsigned n = 1; n <= max_threads * 2; n *= 2){
+        double new_rate = run<NewAllocator<ListNode<long>>>(n, ops);
+        double pool_rate = run<PollAllocator<ListNode<long>>>(n, ops);
+        std::printf("%8u %13.1f M/s %13.1f M/s\n", n, new_rate, pool_rate);
+    }
+    return 0;
+}
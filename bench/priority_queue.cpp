@@ -0,0 +1,135 @@
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "../include/priority_queue.h"
+#include "../include/map.h"
+
+// The Map-as-heap the timer and top-K code used: the smallest key is begin().
+class MultiMapQueue{
+    public:
+        void push(int key){ map_.insert(std::make_pair(key, 0));}
+        int top(){ return map_.begin()->first;}
+        void pop(){ map_.erase(map_.begin());}
+        bool empty() const{ return map_.empty();}
+    private:
+        MultiMap<int, int> map_;
+};
+
+template <size_t ARITY>
+using MinHeap = PriorityQueue<int, std::greater<int>, Vector<int>, ARITY>;
+
+// Timer-like hold model: pop the earliest deadline and push it back a random
+// delay later, so the queue stays at depth elements.
+template <typename QUEUE>
+void hold(const char* name, size_t depth, const std::vector<int>& delays){
+    QUEUE q;
+    for(size_t i = 0; i < depth; i++) q.push(delays[i]);
+    Timer timer;
+    for(int delay : delays){
+        int now = q.top();
+        q.pop();
+        q.push(now + delay);
+    }
+    do_not_optimize(q.top());
+    double ns = timer.nanoseconds() / delays.size();
+    std::printf("%-24s hold  depth %7zu %7.1f ns/pop+push\n", name, depth, ns);
+}
+
+// Builds a queue from keys, one push at a time, and drains it.
+template <typename QUEUE>
+void build_drain(const char* name, const std::vector<int>& keys){
+    Timer timer;
+    QUEUE q;
+    for(int key : keys) q.push(key);
+    double build = timer.nanoseconds() / keys.size();
+    timer.reset();
+    long sum = 0;
+    while(!q.empty()){
+        sum += q.top();
+        q.pop();
+    }
+    do_not_optimize(sum);
+    double drain = timer.nanoseconds() / keys.size();
+    std::printf("%-24s push  %7.1f ns/elem  drain %7.1f ns/elem\n", name, build, drain);
+}
+
+template <size_t ARITY>
+void build_range(const char* name, const std::vector<int>& keys){
+    Timer timer;
+    MinHeap<ARITY> q;
+    q.push_range(keys.begin(), keys.end());
+    do_not_optimize(q.top());
+    std::printf("%-24s push_range %7.1f ns/elem\n", name, timer.nanoseconds() / keys.size());
+}
+
+// Dijkstra-like: id_nr queued ids, each op lowers one id's key. RBTree::erase
+// may free the successor's node, so the map cannot keep an iterator per id
+// and has to look each entry up by key.
+void decrease_multimap(size_t id_nr, const std::vector<int>& ids, const std::vector<int>& cuts){
+    MultiMap<int, int> map;
+    std::vector<int> key(id_nr);
+    for(size_t id = 0; id < id_nr; id++){
+        key[id] = int(id + 1) * 4096;
+        map.insert(std::make_pair(key[id], int(id)));
+    }
+    Timer timer;
+    for(size_t i = 0; i < ids.size(); i++){
+        int id = ids[i];
+        auto it = map.lower_bound(key[id]);
+        while(it->second != id) ++it;
+        map.erase(it);
+        key[id] -= cuts[i];
+        map.insert(std::make_pair(key[id], id));
+    }
+    do_not_optimize(map.begin()->first);
+    std::printf("%-24s decrease_key %7.1f ns/op\n", "MultiMap erase+insert", timer.nanoseconds() / ids.size());
+}
+
+template <size_t ARITY>
+void decrease_indexed(const char* name, size_t id_nr, const std::vector<int>& ids, const std::vector<int>& cuts){
+    IndexedPriorityQueue<int, std::greater<int>, ARITY> q;
+    std::vector<int> key(id_nr);
+    for(size_t id = 0; id < id_nr; id++){
+        key[id] = int(id + 1) * 4096;
+        q.push(id, key[id]);
+    }
+    Timer timer;
+    for(size_t i = 0; i < ids.size(); i++){
+        int id = ids[i];
+        key[id] -= cuts[i];
+        q.decrease_key(id, key[id]);
+    }
+    do_not_optimize(q.top());
+    std::printf("%-24s decrease_key %7.1f ns/op\n", name, timer.nanoseconds() / ids.size());
+}
+
+int main(){
+    std::mt19937 rng(7);
+    const size_t op_nr = 2000000, key_nr = 1000000, id_nr = 100000;
+    std::vector<int> delays(op_nr), keys(key_nr), ids(op_nr), cuts(op_nr);
+    for(int& d : delays) d = int(rng() % 100000);
+    for(int& k : keys) k = int(rng() >> 1);
+    for(int& i : ids) i = int(rng() % id_nr);
+    for(int& c : cuts) c = int(rng() % 64);
+
+    for(size_t depth : {1000, 100000}){
+        hold<MultiMapQueue>("MultiMap<int>", depth, delays);
+        hold<MinHeap<2>>("PriorityQueue arity 2", depth, delays);
+        hold<MinHeap<4>>("PriorityQueue arity 4", depth, delays);
+        hold<MinHeap<8>>("PriorityQueue arity 8", depth, delays);
+    }
+
+    build_drain<MultiMapQueue>("MultiMap<int>", keys);
+    build_drain<MinHeap<2>>("PriorityQueue arity 2", keys);
+    build_drain<MinHeap<4>>("PriorityQueue arity 4", keys);
+    build_drain<MinHeap<8>>("PriorityQueue arity 8", keys);
+    build_range<2>("PriorityQueue arity 2", keys);
+    build_range<4>("PriorityQueue arity 4", keys);
+    build_range<8>("PriorityQueue arity 8", keys);
+
+    decrease_multimap(id_nr, ids, cuts);
+    decrease_indexed<2>("Indexed arity 2", id_nr, ids, cuts);
+    decrease_indexed<4>("Indexed arity 4", id_nr, ids, cuts);
+    decrease_indexed<8>("Indexed arity 8", id_nr, ids, cuts);
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "bench.h"
+#include "../include/queue.h"
+#include "../include/ring_buffer.h"
+
+template <typename T>
+struct CountingAllocator: NewAllocator<T>{
+    typedef T value_type;
+    static size_t calls;
+    CountingAllocator(){}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&){}
+    static T* allocate(size_t obj_nr, void* = nullptr){ calls++; return NewAllocator<T>::allocate(obj_nr);}
+    static void deallocate(T* p, size_t obj_nr){ calls++; NewAllocator<T>::deallocate(p, obj_nr);}
+};
+template <typename T>
+size_t CountingAllocator<T>::calls = 0;
+
+// A queue that hovers around depth elements: every push is matched by a pop.
+template <typename QUEUE>
+void steady(const char* name, size_t depth, size_t op_nr){
+    QUEUE q;
+    for(size_t i = 0; i < depth; i++) q.push(int(i));
+    CountingAllocator<int>::calls = 0;
+    Timer timer;
+    for(size_t i = 0; i < op_nr; i++){
+        q.push(int(i));
+        do_not_optimize(q.front());
+        q.pop();
+    }
+    double ns = timer.nanoseconds() / op_nr;
+    std::printf("%-32s depth %6zu %6.2f ns/push+pop %8zu block allocator calls\n", name, depth, ns, CountingAllocator<int>::calls);
+}
+
+int main(){
+    const size_t op_nr = 20000000;
+    typedef Queue<int, Deque<int, CountingAllocator>> CountingQueue;
+    typedef Queue<int, DynamicRingBuffer<int, CountingAllocator<int>>> RingQueue;
+    for(size_t depth : {16, 1000, 100000}){
+        steady<CountingQueue>("Queue<int>", depth, op_nr);
+        steady<RingQueue>("Queue<int, DynamicRingBuffer>", depth, op_nr);
+    }
+    // Bounded queues never allocate, so CountingAllocator never sees them.
+    steady<Queue<int, RingBuffer<int, 32>>>("Queue<int, RingBuffer<32>>", 16, op_nr);
+    steady<Queue<int, RingBuffer<int, 1024>>>("Queue<int, RingBuffer<1024>>", 1000, op_nr);
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include "bench.h"
+#include "../include/vector.h"
+
+// Runs each kernel over elem_nr elements at every SIMD level the CPU has.
+template <typename T>
+void kernels(const char* type_name, size_t elem_nr){
+    Vector<T> a, b;
+    for(size_t i = 0; i < elem_nr; i++){
+        a.push_back(T(i % 1000));
+        b.push_back(T((i * 7) % 1000));
+    }
+    const char* level_names[] = { "scalar", "sse2", "avx2" };
+    for(int level = simd_detect(); level >= SIMD_SCALAR; level--){
+        simd_set_level(SimdLevel(level));
+        Timer timer;
+        do_not_optimize(a.sum());
+        double sum = timer.nanoseconds(); timer.reset();
+        do_not_optimize(a.dot(b));
+        double dot = timer.nanoseconds(); timer.reset();
+        do_not_optimize(a.count(T(999)));
+        double count = timer.nanoseconds(); timer.reset();
+        do_not_optimize(a.max());
+        double max = timer.nanoseconds(); timer.reset();
+        do_not_optimize(a.find(T(-1)));
+        double find = timer.nanoseconds(); timer.reset();
+        a.add(b);
+        double add = timer.nanoseconds();
+        std::printf("%-7s %-7s sum %6.3f  dot %6.3f  count %6.3f  max %6.3f  find %6.3f  add %6.3f ns/elem\n", type_name, level_names[level],
+                    sum / elem_nr, dot / elem_nr, count / elem_nr, max / elem_nr, find / elem_nr, add / elem_nr);
+    }
+    simd_set_level(simd_detect());
+}
+
+int main(){
+    const size_t elem_nr = 8000000;
+    kernels<int>("int", elem_nr);
+    kernels<float>("float", elem_nr);
+    kernels<double>("double", elem_nr);
+    return 0;
+}
\ No newline at end of file
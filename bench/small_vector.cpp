@@ -0,0 +1,41 @@
+#include <random>
+#include "bench.h"
+#include "../include/vector.h"
+#include "../include/small_vector.h"
+
+template <typename T>
+struct CountingAllocator: NewAllocator<T>{
+    typedef T value_type;
+    static size_t calls;
+    static T* allocate(size_t obj_nr, void* = nullptr){ calls++; return NewAllocator<T>::allocate(obj_nr);}
+};
+template <typename T>
+size_t CountingAllocator<T>::calls = 0;
+
+// Each request collects a handful of ids, most of them fewer than 16, and
+// folds them into a checksum.
+template <typename VECTOR>
+void requests(const char* name, Vector<int>& sizes){
+    CountingAllocator<long>::calls = 0;
+    long sum = 0;
+    Timer timer;
+    for(size_t r = 0; r < sizes.size(); r++){
+        VECTOR ids;
+        for(int i = 0; i < sizes[r]; i++) ids.push_back(r + i);
+        for(long id : ids) sum += id;
+    }
+    double ns = timer.nanoseconds() / sizes.size();
+    do_not_optimize(sum);
+    std::printf("%-36s %8.1f ns/request %6.2f allocations/request\n", name, ns, double(CountingAllocator<long>::calls) / sizes.size());
+}
+
+int main(){
+    const size_t request_nr = 2000000;
+    std::mt19937 rng(42);
+    Vector<int> sizes;
+    for(size_t r = 0; r < request_nr; r++) sizes.push_back(rng() % 10 == 0 ? 16 + rng() % 48 : 1 + rng() % 15);
+
+    requests<Vector<long, CountingAllocator<long>>>("Vector<long>", sizes);
+    requests<SmallVector<long, 16, CountingAllocator<long>>>("SmallVector<long, 16>", sizes);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "bench.h"
+#include "../include/vector.h"
+#include "../include/soa_vector.h"
+
+struct Record{
+    double price;
+    double weight;
+    double f2, f3, f4, f5, f6, f7;
+};
+
+typedef SoaVector<double, double, double, double, double, double, double, double> RecordColumns;
+
+// The scoring loop reads two of the eight fields.
+int main(){
+    const size_t row_nr = 10000000;
+    const int pass_nr = 5;
+    Vector<Record> rows;
+    RecordColumns columns;
+    for(size_t i = 0; i < row_nr; i++){
+        double x = double(i % 1000);
+        rows.push_back(Record{x, 0.5, x, x, x, x, x, x});
+        columns.emplace_back(x, 0.5, x, x, x, x, x, x);
+    }
+
+    Timer timer;
+    double score = 0;
+    for(int pass = 0; pass < pass_nr; pass++){
+        for(const Record& r : rows) score += r.price * r.weight;
+    }
+    do_not_optimize(score);
+    double aos = timer.nanoseconds() / (row_nr * pass_nr);
+
+    timer.reset();
+    score = 0;
+    for(int pass = 0; pass < pass_nr; pass++){
+        const double* price = columns.column<0>();
+        const double* weight = columns.column<1>();
+        for(size_t i = 0; i < columns.size(); i++) score += price[i] * weight[i];
+    }
+    do_not_optimize(score);
+    double soa = timer.nanoseconds() / (row_nr * pass_nr);
+
+    timer.reset();
+    score = 0;
+    for(int pass = 0; pass < pass_nr; pass++){
+        for(auto row : columns) score += std::get<0>(row) * std::get<1>(row);
+    }
+    do_not_optimize(score);
+    double soa_rows = timer.nanoseconds() / (row_nr * pass_nr);
+
+    std::printf("%-40s %6.2f ns/row\n", "Vector<Record>", aos);
+    std::printf("%-40s %6.2f ns/row\n", "SoaVector columns", soa);
+    std::printf("%-40s %6.2f ns/row\n", "SoaVector row iterator", soa_rows);
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <mutex>
+#include <thread>
+#include "bench.h"
+#include "../include/queue.h"
+#include "../include/spsc_ring.h"
+
+// One producer thread hands item_nr longs to the consumer (this thread).
+template <typename PRODUCE, typename CONSUME>
+void handoff(const char* name, long item_nr, PRODUCE produce, CONSUME consume){
+    Timer timer;
+    std::thread producer(produce);
+    long sum = consume();
+    producer.join();
+    do_not_optimize(sum);
+    std::printf("%-36s %7.2f ns/item\n", name, timer.nanoseconds() / item_nr);
+}
+
+int main(){
+    const long item_nr = 10000000;
+    const size_t batch = 64;
+
+    {
+        Queue<long> q;
+        std::mutex lock;
+        handoff("mutex + Queue<long>", item_nr,
+            [&]{ for(long i = 0; i < item_nr; i++){ std::lock_guard<std::mutex> guard(lock); q.push(i);} },
+            [&]{
+                long sum = 0;
+                for(long got = 0; got < item_nr;){
+                    std::unique_lock<std::mutex> guard(lock);
+                    if(q.empty()){ guard.unlock(); std::this_thread::yield(); continue;}
+                    sum += q.front(); q.pop(); got++;
+                }
+                return sum;
+            });
+    }
+    {
+        SpscRing<long, 4096>* ring = new SpscRing<long, 4096>;
+        handoff("SpscRing<long, 4096> try_push/try_pop", item_nr,
+            [&]{ for(long i = 0; i < item_nr;){ if(ring->try_push(i)) i++; else std::this_thread::yield();} },
+            [&]{
+                long sum = 0, v;
+                for(long got = 0; got < item_nr;){
+                    if(ring->try_pop(v)){ sum += v; got++;}
+                    else std::this_thread::yield();
+                }
+                return sum;
+            });
+        delete ring;
+    }
+    {
+        SpscRing<long, 4096>* ring = new SpscRing<long, 4096>;
+        handoff("SpscRing<long, 4096> push_n/pop_n 64", item_nr,
+            [&]{
+                long buf[batch];
+                for(long i = 0; i < item_nr;){
+                    size_t n = std::min<long>(batch, item_nr - i);
+                    for(size_t k = 0; k < n; k++) buf[k] = i + k;
+                    size_t pushed = 0;
+                    while(pushed < n){
+                        size_t m = ring->push_n(buf + pushed, n - pushed);
+                        if(m == 0) std::this_thread::yield();
+                        pushed += m;
+                    }
+                    i += n;
+                }
+            },
+            [&]{
+                long sum = 0, buf[batch];
+                for(long got = 0; got < item_nr;){
+                    size_t n = ring->pop_n(buf, batch);
+                    if(n == 0) std::this_thread::yield();
+                    for(size_t k = 0; k < n; k++) sum += buf[k];
+                    got += n;
+                }
+                return sum;
+            });
+        delete ring;
+    }
+    return 0;
+}
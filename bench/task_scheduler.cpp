@@ -0,0 +1,54 @@
+#include <cmath>
+#include "bench.h"
+#include "../include/vector.h"
+#include "../include/task_scheduler.h"
+
+static long serial_fib(long n){ return n < 2 ? n : serial_fib(n - 1) + serial_fib(n - 2);}
+
+// Fork-join Fibonacci: one spawn per call above the cutoff.
+static long task_fib(long n, long cutoff, long& spawn_nr){
+    if(n < cutoff) return serial_fib(n);
+    long x, y, left_nr = 0, right_nr = 0;
+    TaskGroup group;
+    group.spawn([&]{ x = task_fib(n - 1, cutoff, left_nr);});
+    y = task_fib(n - 2, cutoff, right_nr);
+    group.wait();
+    spawn_nr += left_nr + right_nr + 1;
+    return x + y;
+}
+
+// Iteration i does work proportional to i, so equal static chunks would
+// leave the threads with the early indices idle.
+static double skewed(size_t i){
+    double acc = 0;
+    for(size_t k = 0; k < i * 64; k++) acc += std::sqrt(double(k));
+    return acc;
+}
+
+int main(){
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    std::printf("%zu threads\n", scheduler.thread_count());
+
+    const long n = 32;
+    Timer timer;
+    do_not_optimize(serial_fib(n));
+    double serial = timer.seconds();
+    for(long cutoff : {12, 16, 20}){
+        long spawn_nr = 0;
+        timer.reset();
+        do_not_optimize(task_fib(n, cutoff, spawn_nr));
+        double tasks = timer.seconds();
+        std::printf("fib(%ld) cutoff %2ld  serial %7.1f ms  tasks %7.1f ms  %8ld spawns  %6.1f ns overhead/spawn\n",
+                    n, cutoff, serial * 1000, tasks * 1000, spawn_nr, (tasks - serial) * 1e9 / spawn_nr);
+    }
+
+    const size_t iter_nr = 1024;
+    Vector<double> out(iter_nr, 0.0);
+    timer.reset();
+    for(size_t i = 0; i < iter_nr; i++) out[i] = skewed(i);
+    serial = timer.seconds();
+    timer.reset();
+    scheduler.parallel_for(iter_nr, [&](size_t i){ out[i] = skewed(i);});
+    std::printf("skewed parallel_for  serial %7.1f ms  tasks %7.1f ms\n", serial * 1000, timer.seconds() * 1000);
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "bench.h"
+#include "../include/vector.h"
+#include "../include/deque.h"
+#include "../include/list.h"
+
+// Appends every element of source to a Vector that already holds some data,
+// once element by element and once as a single range.
+template <typename SOURCE>
+void append(const char* name, SOURCE& source){
+    Vector<long> seed(1000, 1);
+
+    Timer timer;
+    {
+        Vector<long> v(seed);
+        for(auto it = source.begin(); it != source.end(); ++it) v.push_back(*it);
+        do_not_optimize(v.size());
+    }
+    double loop = timer.seconds();
+
+    timer.reset();
+    {
+        Vector<long> v(seed);
+        v.append_range(source);
+        do_not_optimize(v.size());
+    }
+    double range = timer.seconds();
+
+    timer.reset();
+    {
+        Vector<long> v(seed);
+        v.insert(v.begin() + 500, source.begin(), source.end());
+        do_not_optimize(v.size());
+    }
+    double middle = timer.seconds();
+
+    std::printf("%-12s push_back loop %7.2f ms  append_range %7.2f ms  insert at 500 %7.2f ms\n",
+                name, loop * 1000, range * 1000, middle * 1000);
+}
+
+int main(){
+    const size_t elem_nr = 1000000;
+    Deque<long> deque;
+    List<long> list;
+    for(size_t i = 0; i < elem_nr; i++){
+        deque.push_back(i);
+        list.push_back(i);
+    }
+    append("Deque<long>", deque);
+    append("List<long>", list);
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "../include/vector.h"
+
+struct Pod64{
+    long words[8];
+};
+
+template <typename T>
+T make_value(size_t i){ return T(i);}
+template <>
+std::string make_value<std::string>(size_t i){ return std::string(i % 32, 'x');}
+template <>
+Pod64 make_value<Pod64>(size_t i){ Pod64 p = {}; p.words[0] = i; return p;}
+
+template <typename VECTOR>
+void push_back_growth(const char* name, size_t elem_nr){
+    typedef typename VECTOR::value_type T;
+    T value = make_value<T>(elem_nr);
+    Timer timer;
+    {
+        VECTOR v;
+        for(size_t i = 0; i < elem_nr; i++) v.push_back(value);
+        do_not_optimize(v.size());
+    }
+    std::printf("%-32s %8.1f ms\n", name, timer.seconds() * 1000);
+}
+
+int main(){
+    const size_t elem_nr = 10000000;
+    push_back_growth<Vector<int>>("Vector<int>", elem_nr);
+    push_back_growth<std::vector<int>>("std::vector<int>", elem_nr);
+    push_back_growth<Vector<std::string>>("Vector<std::string>", elem_nr);
+    push_back_growth<std::vector<std::string>>("std::vector<std::string>", elem_nr);
+    push_back_growth<Vector<Pod64>>("Vector<Pod64>", elem_nr);
+    push_back_growth<std::vector<Pod64>>("std::vector<Pod64>", elem_nr);
+    return 0;
+}
\ No newline at end of file
@@ -3,103 +3,712 @@
 
 #include <iostream>
 #include <cstring>
+#include <cstdint>
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+#include "chunk_source.h"
+
+#ifndef POOL_ALLOCATOR_THREADS
+#define POOL_ALLOCATOR_THREADS 1
+#endif
+
+#ifndef POOL_ALLOCATOR_STATS
+#define POOL_ALLOCATOR_STATS 0
+#endif
+
+#if POOL_ALLOCATOR_STATS
+#define POOL_STAT(expr) expr
+#else
+#define POOL_STAT(expr)
+#endif
+
+#define CACHE_LINE_SIZE 64
+
+// Plain operator new only guarantees __STDCPP_DEFAULT_NEW_ALIGNMENT__, so
+// over-aligned requests go through the align_val_t overloads.
+inline void* aligned_new(size_t bytes_nr, size_t align){
+    if(align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) return ::operator new(bytes_nr, std::align_val_t(align));
+    return ::operator new(bytes_nr);
+}
+
+inline void aligned_delete(void* p, size_t align){
+    if(align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) ::operator delete(p, std::align_val_t(align));
+    else ::operator delete(p);
+}
+
+// allocate_batch/deallocate_batch hand out and take back obj_nr separate
+// objects at once. Until they are constructed (and once they are destroyed)
+// the objects are chained through their first word, see batch_next().
+template <typename T>
+inline T*& batch_next(T* p){
+    static_assert(sizeof(T) >= sizeof(T*), "batch objects must hold a pointer");
+    return *reinterpret_cast<T**>(p);
+}
+
+template <typename ALLOC, typename T>
+inline T* allocate_each(ALLOC& alloc, size_t obj_nr){
+    T* head = nullptr;
+    for(size_t i = 0; i < obj_nr; i++){
+        T* p = alloc.allocate(1);
+        batch_next(p) = head;
+        head = p;
+    }
+    return head;
+}
+
+template <typename ALLOC, typename T>
+inline void deallocate_each(ALLOC& alloc, T* first, size_t obj_nr){
+    for(size_t i = 0; i < obj_nr; i++){
+        T* next = batch_next(first);
+        alloc.deallocate(first, 1);
+        first = next;
+    }
+}
 
 template <typename T>
 class NewAllocator{
     public:
         static T* allocate(size_t obj_nr, void* = static_cast<void*>(nullptr)){
             size_t bytes_nr = obj_nr * sizeof(T);
-            return static_cast<T*>(::operator new(bytes_nr));
+            return static_cast<T*>(aligned_new(bytes_nr, alignof(T)));
+        }
+        static void deallocate(T* p, size_t){
+            aligned_delete(p, alignof(T));
+        }
+        // Every object still needs its own operator new so it can be freed
+        // on its own later.
+        static T* allocate_batch(size_t obj_nr){
+            NewAllocator alloc;
+            return allocate_each<NewAllocator, T>(alloc, obj_nr);
         }
-        static void deallocate(T* p, size_t){ 
-            operator delete(p);
+        static void deallocate_batch(T* first, T*, size_t obj_nr){
+            NewAllocator alloc;
+            deallocate_each(alloc, first, obj_nr);
         }
 };
 
+// Allocates every buffer on an ALIGN boundary, e.g. to keep Vector and
+// Deque blocks on their own cache lines.
+template <typename T, size_t ALIGN>
+class AlignedAllocator{
+    static_assert((ALIGN & (ALIGN - 1)) == 0, "ALIGN must be a power of two");
+    public:
+        enum{ALIGNMENT = ALIGN > alignof(T) ? ALIGN : alignof(T)};
+
+        AlignedAllocator() = default;
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U, ALIGN>&){}
+
+        static T* allocate(size_t obj_nr, void* = static_cast<void*>(nullptr)){
+            size_t bytes_nr = obj_nr * sizeof(T);
+            return static_cast<T*>(::operator new(bytes_nr, std::align_val_t(ALIGNMENT)));
+        }
+        static void deallocate(T* p, size_t){
+            ::operator delete(p, std::align_val_t(ALIGNMENT));
+        }
+};
+
+template <typename T>
+using CacheAlignedAllocator = AlignedAllocator<T, CACHE_LINE_SIZE>;
+
+// With POOL_ALLOCATOR_THREADS every thread keeps its own free lists and only
+// takes the central lock to move REFILL_COUNT objects at a time.
 class PoolAllocatorBase{
-    protected:  
+    protected:
         struct chunk_node{
             chunk_node* next;
         };
+        // Every chunk taken from the chunk source starts with a header, so
+        // trim() and reset() know which memory the pool owns.
+        struct chunk_header{
+            chunk_header* next;
+            size_t size;
+            void (*deallocate)(void* p, size_t bytes_nr);
+        };
         enum{POOL_ALIGN = 8};
         enum{MAX_CHUNK_SIZE = 128};
         enum{POOL_ARRAY_SIZE = MAX_CHUNK_SIZE / POOL_ALIGN};
+        enum{REFILL_COUNT = 20};
+        enum{CHUNK_HEADER_SIZE = (sizeof(chunk_header) + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1)};
+#if POOL_ALLOCATOR_STATS
+    public:
+        struct pool_stats{
+            struct size_class{
+                size_t obj_size;
+                size_t allocations;
+                size_t frees;
+                size_t refills;
+                size_t chunks;
+                size_t free_bytes;
+                size_t leftover_bytes;
+            };
+            size_class classes[POOL_ARRAY_SIZE];
+            size_t heap_size;
+            size_t large_allocations;
+            size_t large_frees;
+            size_t large_bytes;
+
+            void show() const{
+                std::cout << "obj_size allocations frees refills chunks free_bytes leftover_bytes" << std::endl;
+                for(const size_class& c : classes){
+                    std::cout << c.obj_size << ' ' << c.allocations << ' ' << c.frees << ' ' << c.refills << ' '
+                              << c.chunks << ' ' << c.free_bytes << ' ' << c.leftover_bytes << std::endl;
+                }
+                std::cout << "heap_size: " << heap_size << std::endl;
+                std::cout << "large allocations: " << large_allocations << " frees: " << large_frees
+                          << " bytes: " << large_bytes << std::endl;
+            }
+        };
     private:
+        // Only the owning thread writes a stat_counter, so a relaxed
+        // load/store pair is enough and stays off the locked bus.
+        struct stat_counter{
+            std::atomic<size_t> value;
+
+            stat_counter():value(0){}
+            void add(size_t n){ value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);}
+            size_t get() const{ return value.load(std::memory_order_relaxed);}
+        };
+        struct local_stats{
+            stat_counter allocations[POOL_ARRAY_SIZE];
+            stat_counter frees[POOL_ARRAY_SIZE];
+        };
+        // Guarded by lock_, except the large_* counters.
+        struct central_stats{
+            size_t refills[POOL_ARRAY_SIZE];
+            size_t chunks[POOL_ARRAY_SIZE];
+            size_t stocked[POOL_ARRAY_SIZE];
+            size_t leftover_bytes[POOL_ARRAY_SIZE];
+            size_t retired_allocations[POOL_ARRAY_SIZE];
+            size_t retired_frees[POOL_ARRAY_SIZE];
+            std::atomic<size_t> large_allocations;
+            std::atomic<size_t> large_frees;
+            std::atomic<size_t> large_bytes;
+        };
+        static central_stats stats_;
+#endif
+    private:
+#if POOL_ALLOCATOR_THREADS
+        typedef std::mutex pool_mutex;
+
+        struct thread_cache{
+            chunk_node* free_list[POOL_ARRAY_SIZE];
+            size_t count[POOL_ARRAY_SIZE];
+            unsigned epoch;
+#if POOL_ALLOCATOR_STATS
+            local_stats stats;
+            thread_cache* prev;
+            thread_cache* next;
+#endif
+
+            thread_cache():free_list(), count(), epoch(epoch_.load(std::memory_order_relaxed)){
+#if POOL_ALLOCATOR_STATS
+                std::lock_guard<pool_mutex> guard(lock_);
+                prev = nullptr;
+                next = caches_;
+                if(caches_ != nullptr) caches_->prev = this;
+                caches_ = this;
+#endif
+            }
+            // Objects cached before a reset() point into released chunks.
+            void check_epoch(){
+                unsigned current = epoch_.load(std::memory_order_relaxed);
+                if(epoch != current){
+                    std::fill(free_list, free_list + POOL_ARRAY_SIZE, nullptr);
+                    std::fill(count, count + POOL_ARRAY_SIZE, 0);
+                    epoch = current;
+                }
+            }
+            void flush(){
+                check_epoch();
+                for(size_t i = 0; i < POOL_ARRAY_SIZE; i++){
+                    if(free_list[i] != nullptr) release_n(i, free_list[i], count[i]);
+                    free_list[i] = nullptr;
+                    count[i] = 0;
+                }
+            }
+            ~thread_cache(){
+                flush();
+#if POOL_ALLOCATOR_STATS
+                std::lock_guard<pool_mutex> guard(lock_);
+                for(size_t i = 0; i < POOL_ARRAY_SIZE; i++){
+                    stats_.retired_allocations[i] += stats.allocations[i].get();
+                    stats_.retired_frees[i] += stats.frees[i].get();
+                }
+                if(prev != nullptr) prev->next = next;
+                else caches_ = next;
+                if(next != nullptr) next->prev = prev;
+#endif
+                cache_dead_ = true;
+            }
+        };
+        static thread_local thread_cache cache_;
+        // Set once cache_ is destroyed. Objects freed later in the thread's
+        // exit (by static-duration containers, say) go to the central pool.
+        static thread_local bool cache_dead_;
+        static std::atomic<unsigned> epoch_;
+#if POOL_ALLOCATOR_STATS
+        static thread_cache* caches_;
+#endif
+#else
+        struct pool_mutex{
+            void lock(){}
+            void unlock(){}
+        };
+#if POOL_ALLOCATOR_STATS
+        static local_stats local_stats_;
+#endif
+#endif
         static char* start_free_;
         static char* end_free_;
         static size_t heap_size_;
-        static chunk_node* volatile pool_array_[POOL_ARRAY_SIZE];
+        static chunk_node* pool_array_[POOL_ARRAY_SIZE];
+        static pool_mutex lock_;
+        static ChunkSource chunk_source_;
+        static chunk_header* chunks_;
+        static size_t chunk_nr_;
     private:
+#if POOL_ALLOCATOR_THREADS
+        static thread_cache* local_cache(){
+            return cache_dead_? nullptr : &cache_;
+        }
+#endif
         static size_t round_up(size_t obj_size){
             return (obj_size + POOL_ALIGN - 1) & (~(POOL_ALIGN - 1));
         }
+        static size_t class_index(size_t obj_size){
+            return (obj_size == 0)? 0 : round_up(obj_size) / POOL_ALIGN - 1;
+        }
+        // Objects of a size class are aligned to the largest power of two
+        // dividing the class size, so any T with sizeof(T) <= MAX_CHUNK_SIZE
+        // gets alignof(T) from the class sizeof(T) rounds up to.
+        static size_t class_align(size_t obj_size){
+            return obj_size & (~obj_size + 1);
+        }
+        static char* align_up(char* p, size_t align){
+            return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + align - 1) & ~(uintptr_t(align) - 1));
+        }
+        static void push_free(char* p, size_t size){
+            chunk_node* node = reinterpret_cast<chunk_node*>(p);
+            node->next = pool_array_[class_index(size)];
+            pool_array_[class_index(size)] = node;
+        }
+        // Splits [p, p + size) into pieces that keep the class alignment
+        // invariant and puts them on the free lists.
+        static void push_leftover(char* p, size_t size){
+            while(size > 0){
+                size_t piece = std::min(class_align(reinterpret_cast<uintptr_t>(p)), size_t(MAX_CHUNK_SIZE));
+                while(piece > size) piece >>= 1;
+                POOL_STAT(stats_.leftover_bytes[class_index(piece)] += piece);
+                POOL_STAT(stats_.stocked[class_index(piece)]++);
+                push_free(p, piece);
+                p += piece;
+                size -= piece;
+            }
+        }
+        // Caller holds lock_.
         static void* allocate_chunk(int& obj_nr, size_t obj_size){
             size_t alloc_size = obj_nr * obj_size;
+            char* aligned = align_up(start_free_, class_align(obj_size));
+            size_t left = (aligned <= end_free_)? end_free_ - aligned : 0;
             void* result = nullptr;
-            if(static_cast<size_t>(end_free_ - start_free_)
-                 >= alloc_size){
+            if(left >= obj_size && aligned != start_free_){
+                push_leftover(start_free_, aligned - start_free_);
+                start_free_ = aligned;
+            }
+            if(left >= alloc_size){
                 result = start_free_;
                 start_free_ = start_free_ + alloc_size;
                 return result;
-            }else if(static_cast<size_t>(end_free_ - start_free_) >= obj_size){
-                obj_nr = (end_free_ - start_free_) / obj_size;
+            }else if(left >= obj_size){
+                obj_nr = left / obj_size;
                 result = start_free_;
                 start_free_ = start_free_ + obj_size * obj_nr;
                 return result;
             }else{
-                int t = obj_size / POOL_ALIGN - 1;
-                for(int i = t - 1, sz = obj_size >> 1;i >= 0; i--, sz = sz >> 1){
-                    if(end_free_ - start_free_ >= sz){
-                        reinterpret_cast<chunk_node*>(start_free_)->next = pool_array_[i];
-                        pool_array_[i] = reinterpret_cast<chunk_node*>(start_free_);
-                        start_free_ = start_free_ + sz;
-                    }
+                if(start_free_ != end_free_){
+                    push_leftover(start_free_, end_free_ - start_free_);
+                    start_free_ = end_free_;
                 }
-                void* p = nullptr;
-                size_t new_size = (alloc_size << 1) + (heap_size_ >> 4);
-                p = ::operator new(new_size, std::nothrow);
+                size_t new_size = (alloc_size << 1) + round_up(heap_size_ >> 4) + class_align(obj_size);
+                void* p = chunk_source_.allocate(new_size + CHUNK_HEADER_SIZE);
                 if(p == nullptr){
-                    for(int i = t + 1, sz = obj_size << 1; i < POOL_ARRAY_SIZE; i++, sz = sz << 1){
+                    for(size_t i = class_index(obj_size) + 1; i < POOL_ARRAY_SIZE; i++){
                         if(pool_array_[i] != nullptr){
-                            start_free_ = reinterpret_cast<char*>(pool_array_[i]), end_free_ = reinterpret_cast<char*>(pool_array_[i]) + sz;
+                            POOL_STAT(stats_.stocked[i]--);
+                            start_free_ = reinterpret_cast<char*>(pool_array_[i]), end_free_ = start_free_ + (i + 1) * POOL_ALIGN;
                             pool_array_[i] = pool_array_[i]->next;
                             return allocate_chunk(obj_nr, obj_size);
                         }
                     }
                     return nullptr;
                 }else{
-                    start_free_ = static_cast<char*>(p), end_free_ =  static_cast<char*>(p) + new_size;
-                    heap_size_ += new_size;
+                    chunk_header* chunk = static_cast<chunk_header*>(p);
+                    chunk->next = chunks_;
+                    chunk->size = new_size + CHUNK_HEADER_SIZE;
+                    chunk->deallocate = chunk_source_.deallocate;
+                    chunks_ = chunk;
+                    chunk_nr_++;
+                    start_free_ = static_cast<char*>(p) + CHUNK_HEADER_SIZE, end_free_ =  static_cast<char*>(p) + chunk->size;
+                    heap_size_ += chunk->size;
+                    POOL_STAT(stats_.chunks[class_index(obj_size)]++);
                     return allocate_chunk(obj_nr, obj_size);
-                }      
+                }
             }
         }
-    protected:
-        static chunk_node* volatile* get_free_list(size_t obj_size){
-            return pool_array_+ (round_up(obj_size) / POOL_ALIGN - 1);
+        // Takes up to obj_nr objects of class index off the central pool and
+        // returns them as a nullptr-terminated list. Caller holds lock_.
+        static chunk_node* fetch_n(size_t index, int& obj_nr, chunk_node*& tail){
+            chunk_node* head = pool_array_[index];
+            if(head != nullptr){
+                tail = head;
+                int n = 1;
+                while(n < obj_nr && tail->next != nullptr) tail = tail->next, n++;
+                pool_array_[index] = tail->next;
+                tail->next = nullptr;
+                obj_nr = n;
+                return head;
+            }
+            head = refill(index, obj_nr);
+            tail = reinterpret_cast<chunk_node*>(reinterpret_cast<char*>(head) + (obj_nr - 1) * (index + 1) * POOL_ALIGN);
+            return head;
         }
-        static void* refill(size_t obj_size){
-            int obj_nr = 20;
-            size_t round_obj_size = round_up(obj_size);
-            void* p = allocate_chunk(obj_nr, round_obj_size);
+        static chunk_node* refill(size_t index, int& obj_nr){
+            size_t obj_size = (index + 1) * POOL_ALIGN;
+            char* p = static_cast<char*>(allocate_chunk(obj_nr, obj_size));
             if(p == nullptr){
-                
+                throw std::bad_alloc();
             }
-            int off = round_obj_size / POOL_ALIGN - 1;
-            pool_array_[off] = reinterpret_cast<chunk_node*>((static_cast<char*>(p) + round_obj_size));
-            char* start = static_cast<char*>(p) + round_obj_size;
-            for(int i = 1; i < obj_nr; i++){
-               reinterpret_cast<chunk_node*>(start)->next = pool_array_[off];
-               pool_array_[off] = reinterpret_cast<chunk_node*>(start);
-               start += round_obj_size;
+            POOL_STAT(stats_.refills[index]++);
+            POOL_STAT(stats_.stocked[index] += obj_nr);
+            for(int i = 0; i < obj_nr - 1; i++){
+                reinterpret_cast<chunk_node*>(p + i * obj_size)->next = reinterpret_cast<chunk_node*>(p + (i + 1) * obj_size);
+            }
+            reinterpret_cast<chunk_node*>(p + (obj_nr - 1) * obj_size)->next = nullptr;
+            return reinterpret_cast<chunk_node*>(p);
+        }
+        static void release_n(size_t index, chunk_node* head, size_t obj_nr){
+            chunk_node* tail = head;
+            for(size_t i = 1; i < obj_nr; i++) tail = tail->next;
+            release_chain(index, head, tail);
+        }
+        static void release_chain(size_t index, chunk_node* head, chunk_node* tail){
+            std::lock_guard<pool_mutex> guard(lock_);
+            tail->next = pool_array_[index];
+            pool_array_[index] = head;
+        }
+    protected:
+        static void* pool_allocate(size_t bytes_nr){
+            size_t index = class_index(bytes_nr);
+#if POOL_ALLOCATOR_THREADS
+            if(local_cache() == nullptr){
+                std::lock_guard<pool_mutex> guard(lock_);
+                int obj_nr = 1;
+                chunk_node* tail = nullptr;
+                POOL_STAT(stats_.retired_allocations[index]++);
+                return fetch_n(index, obj_nr, tail);
             }
+            thread_cache& cache = cache_;
+            cache.check_epoch();
+            chunk_node* p = cache.free_list[index];
+            if(p == nullptr){
+                int obj_nr = REFILL_COUNT;
+                chunk_node* tail = nullptr;
+                {
+                    std::lock_guard<pool_mutex> guard(lock_);
+                    p = fetch_n(index, obj_nr, tail);
+                }
+                cache.count[index] = obj_nr;
+            }
+            cache.free_list[index] = p->next;
+            cache.count[index]--;
+            POOL_STAT(cache.stats.allocations[index].add(1));
             return p;
+#else
+            chunk_node* p = pool_array_[index];
+            if(p == nullptr){
+                int obj_nr = REFILL_COUNT;
+                p = refill(index, obj_nr);
+            }
+            pool_array_[index] = p->next;
+            POOL_STAT(local_stats_.allocations[index].add(1));
+            return p;
+#endif
         }
+        static void pool_deallocate(void* p, size_t bytes_nr){
+            size_t index = class_index(bytes_nr);
+            chunk_node* node = static_cast<chunk_node*>(p);
+#if POOL_ALLOCATOR_THREADS
+            if(local_cache() == nullptr){
+                std::lock_guard<pool_mutex> guard(lock_);
+                node->next = pool_array_[index];
+                pool_array_[index] = node;
+                POOL_STAT(stats_.retired_frees[index]++);
+                return;
+            }
+            thread_cache& cache = cache_;
+            cache.check_epoch();
+            node->next = cache.free_list[index];
+            cache.free_list[index] = node;
+            POOL_STAT(cache.stats.frees[index].add(1));
+            if(++cache.count[index] > 2 * REFILL_COUNT){
+                chunk_node* tail = node;
+                for(int i = 1; i < REFILL_COUNT; i++) tail = tail->next;
+                cache.free_list[index] = tail->next;
+                cache.count[index] -= REFILL_COUNT;
+                tail->next = nullptr;
+                release_n(index, node, REFILL_COUNT);
+            }
+#else
+            node->next = pool_array_[index];
+            pool_array_[index] = node;
+            POOL_STAT(local_stats_.frees[index].add(1));
+#endif
+        }
+        // Returns obj_nr objects chained through chunk_node::next. Whatever the
+        // thread cache cannot cover is carved in one go under a single lock.
+        static void* pool_allocate_batch(size_t bytes_nr, size_t obj_nr){
+            size_t index = class_index(bytes_nr);
+            chunk_node* head = nullptr;
+            chunk_node** link = &head;
+            size_t got = 0;
+#if POOL_ALLOCATOR_THREADS
+            if(thread_cache* cache = local_cache()){
+                cache->check_epoch();
+                while(got < obj_nr && cache->free_list[index] != nullptr){
+                    *link = cache->free_list[index];
+                    cache->free_list[index] = (*link)->next;
+                    cache->count[index]--;
+                    link = &(*link)->next;
+                    got++;
+                }
+                POOL_STAT(cache->stats.allocations[index].add(obj_nr));
+            }else{
+#if POOL_ALLOCATOR_STATS
+                std::lock_guard<pool_mutex> guard(lock_);
+                stats_.retired_allocations[index] += obj_nr;
+#endif
+            }
+#else
+            POOL_STAT(local_stats_.allocations[index].add(obj_nr));
+#endif
+            if(got < obj_nr){
+                std::lock_guard<pool_mutex> guard(lock_);
+                try{
+                    while(got < obj_nr){
+                        int want = static_cast<int>(std::min(obj_nr - got, size_t(1) << 30));
+                        chunk_node* tail = nullptr;
+                        *link = fetch_n(index, want, tail);
+                        link = &tail->next;
+                        got += want;
+                    }
+                }catch(...){
+                    *link = pool_array_[index];
+                    if(head != nullptr) pool_array_[index] = head;
+                    throw;
+                }
+            }
+            *link = nullptr;
+            return head;
+        }
+        static void pool_deallocate_batch(void* first, void* last, size_t bytes_nr, size_t obj_nr){
+            size_t index = class_index(bytes_nr);
+            chunk_node* head = static_cast<chunk_node*>(first);
+            chunk_node* tail = static_cast<chunk_node*>(last);
+#if POOL_ALLOCATOR_THREADS
+            thread_cache* cache = local_cache();
+            if(cache == nullptr){
+                std::lock_guard<pool_mutex> guard(lock_);
+                tail->next = pool_array_[index];
+                pool_array_[index] = head;
+                POOL_STAT(stats_.retired_frees[index] += obj_nr);
+                return;
+            }
+            cache->check_epoch();
+            POOL_STAT(cache->stats.frees[index].add(obj_nr));
+            if(cache->count[index] + obj_nr <= 2 * REFILL_COUNT){
+                tail->next = cache->free_list[index];
+                cache->free_list[index] = head;
+                cache->count[index] += obj_nr;
+            }else{
+                release_chain(index, head, tail);
+            }
+#else
+            POOL_STAT(local_stats_.frees[index].add(obj_nr));
+            tail->next = pool_array_[index];
+            pool_array_[index] = head;
+#endif
+        }
+        static void large_allocated([[maybe_unused]] size_t bytes_nr){
+            POOL_STAT(stats_.large_allocations.fetch_add(1, std::memory_order_relaxed));
+            POOL_STAT(stats_.large_bytes.fetch_add(bytes_nr, std::memory_order_relaxed));
+        }
+        static void large_deallocated(size_t){
+            POOL_STAT(stats_.large_frees.fetch_add(1, std::memory_order_relaxed));
+        }
+    public:
+        // Must be called before the pool hands out its first object.
+        static void set_chunk_source(const ChunkSource& source){
+            std::lock_guard<pool_mutex> guard(lock_);
+            chunk_source_ = source;
+        }
+        template <typename SOURCE>
+        static void use_chunk_source(){
+            set_chunk_source(make_chunk_source<SOURCE>());
+        }
+
+        // Returns every chunk whose objects are all back on the central free
+        // lists to its chunk source. The calling thread's cache is flushed
+        // first; objects cached by other threads keep their chunks alive.
+        static size_t trim(){
+#if POOL_ALLOCATOR_THREADS
+            if(thread_cache* cache = local_cache()) cache->flush();
+#endif
+            std::lock_guard<pool_mutex> guard(lock_);
+            if(chunk_nr_ == 0) return 0;
+            chunk_header** sorted = static_cast<chunk_header**>(::operator new(chunk_nr_ * sizeof(chunk_header*), std::nothrow));
+            size_t* free_bytes = static_cast<size_t*>(::operator new(chunk_nr_ * sizeof(size_t), std::nothrow));
+            if(sorted == nullptr || free_bytes == nullptr){
+                ::operator delete(sorted);
+                ::operator delete(free_bytes);
+                return 0;
+            }
+            size_t n = 0;
+            for(chunk_header* chunk = chunks_; chunk != nullptr; chunk = chunk->next) sorted[n++] = chunk;
+            std::sort(sorted, sorted + n);
+            std::fill(free_bytes, free_bytes + n, 0);
+            auto owner = [sorted, n](const void* p){
+                return std::upper_bound(sorted, sorted + n, p, [](const void* q, const chunk_header* c){ return q < static_cast<const void*>(c); }) - sorted - 1;
+            };
+            if(start_free_ != end_free_) free_bytes[owner(start_free_)] += end_free_ - start_free_;
+            for(size_t i = 0; i < POOL_ARRAY_SIZE; i++){
+                for(chunk_node* node = pool_array_[i]; node != nullptr; node = node->next){
+                    free_bytes[owner(node)] += (i + 1) * POOL_ALIGN;
+                }
+            }
+            size_t released = 0;
+            for(size_t i = 0; i < n; i++){
+                // Mark fully free chunks by clearing their entry.
+                if(free_bytes[i] == sorted[i]->size - CHUNK_HEADER_SIZE) free_bytes[i] = 0;
+                else free_bytes[i] = 1;
+            }
+            for(size_t i = 0; i < POOL_ARRAY_SIZE; i++){
+                chunk_node** link = &pool_array_[i];
+                while(*link != nullptr){
+                    if(free_bytes[owner(*link)] == 0){
+                        POOL_STAT(stats_.stocked[i]--);
+                        *link = (*link)->next;
+                    }else{
+                        link = &(*link)->next;
+                    }
+                }
+            }
+            if(start_free_ != end_free_ && free_bytes[owner(start_free_)] == 0) start_free_ = end_free_ = nullptr;
+            chunk_header** link = &chunks_;
+            while(*link != nullptr){
+                chunk_header* chunk = *link;
+                if(free_bytes[owner(chunk)] == 0){
+                    *link = chunk->next;
+                    chunk_nr_--;
+                    heap_size_ -= chunk->size;
+                    released += chunk->size;
+                    chunk->deallocate(chunk, chunk->size);
+                }else{
+                    link = &chunk->next;
+                }
+            }
+            ::operator delete(sorted);
+            ::operator delete(free_bytes);
+            return released;
+        }
+
+        // Drops every pool allocation at once. No object handed out by the
+        // pool may be used afterwards, and no other thread may be inside the
+        // pool while reset() runs.
+        static void reset(){
+            std::lock_guard<pool_mutex> guard(lock_);
+#if POOL_ALLOCATOR_THREADS
+            epoch_.fetch_add(1, std::memory_order_relaxed);
+#endif
+            while(chunks_ != nullptr){
+                chunk_header* chunk = chunks_;
+                chunks_ = chunk->next;
+                chunk->deallocate(chunk, chunk->size);
+            }
+            chunk_nr_ = 0;
+            heap_size_ = 0;
+            start_free_ = end_free_ = nullptr;
+            std::fill(pool_array_, pool_array_ + POOL_ARRAY_SIZE, nullptr);
+#if POOL_ALLOCATOR_STATS
+            // Rebase the stock so that free_bytes reads zero again.
+            pool_stats snapshot = unlocked_stats();
+            for(size_t i = 0; i < POOL_ARRAY_SIZE; i++){
+                stats_.stocked[i] -= snapshot.classes[i].free_bytes / snapshot.classes[i].obj_size;
+            }
+#endif
+        }
+#if POOL_ALLOCATOR_STATS
+        static pool_stats stats(){
+            std::lock_guard<pool_mutex> guard(lock_);
+            return unlocked_stats();
+        }
+    private:
+        static pool_stats unlocked_stats(){
+            pool_stats result;
+            for(size_t i = 0; i < POOL_ARRAY_SIZE; i++){
+                pool_stats::size_class& c = result.classes[i];
+                c.obj_size = (i + 1) * POOL_ALIGN;
+#if POOL_ALLOCATOR_THREADS
+                c.allocations = stats_.retired_allocations[i];
+                c.frees = stats_.retired_frees[i];
+                for(thread_cache* cache = caches_; cache != nullptr; cache = cache->next){
+                    c.allocations += cache->stats.allocations[i].get();
+                    c.frees += cache->stats.frees[i].get();
+                }
+#else
+                c.allocations = local_stats_.allocations[i].get();
+                c.frees = local_stats_.frees[i].get();
+#endif
+                c.refills = stats_.refills[i];
+                c.chunks = stats_.chunks[i];
+                c.free_bytes = (stats_.stocked[i] + c.frees - c.allocations) * c.obj_size;
+                c.leftover_bytes = stats_.leftover_bytes[i];
+            }
+            result.heap_size = heap_size_;
+            result.large_allocations = stats_.large_allocations.load(std::memory_order_relaxed);
+            result.large_frees = stats_.large_frees.load(std::memory_order_relaxed);
+            result.large_bytes = stats_.large_bytes.load(std::memory_order_relaxed);
+            return result;
+        }
+#endif
 };
 
 char* PoolAllocatorBase::start_free_ = nullptr;
 char* PoolAllocatorBase::end_free_ = nullptr;
 size_t PoolAllocatorBase::heap_size_ = 0;
+PoolAllocatorBase::chunk_node* PoolAllocatorBase::pool_array_[POOL_ARRAY_SIZE] = {};
+PoolAllocatorBase::pool_mutex PoolAllocatorBase::lock_;
+ChunkSource PoolAllocatorBase::chunk_source_ = make_chunk_source<NewChunkSource>();
+PoolAllocatorBase::chunk_header* PoolAllocatorBase::chunks_ = nullptr;
+size_t PoolAllocatorBase::chunk_nr_ = 0;
+#if POOL_ALLOCATOR_THREADS
+thread_local PoolAllocatorBase::thread_cache PoolAllocatorBase::cache_;
+thread_local bool PoolAllocatorBase::cache_dead_ = false;
+std::atomic<unsigned> PoolAllocatorBase::epoch_(0);
+#endif
+#if POOL_ALLOCATOR_STATS
+PoolAllocatorBase::central_stats PoolAllocatorBase::stats_;
+#if POOL_ALLOCATOR_THREADS
+PoolAllocatorBase::thread_cache* PoolAllocatorBase::caches_ = nullptr;
+#else
+PoolAllocatorBase::local_stats PoolAllocatorBase::local_stats_;
+#endif
+#endif
 
 template <typename T>
 class PollAllocator:public PoolAllocatorBase{
@@ -107,29 +716,153 @@ public:
     static T* allocate(size_t obj_nr, void* = static_cast<void*>(nullptr)){
         size_t bytes_nr = obj_nr * sizeof(T);
         if(bytes_nr > MAX_CHUNK_SIZE){
-            return static_cast<T*>(::operator new(bytes_nr));
-        }
-        chunk_node** free_list = get_free_list(bytes_nr);
-        if(*free_list == nullptr){
-            void* p = refill(bytes_nr);
-            return static_cast<T*>(p);
-        }else{
-            void* p = static_cast<void*>(*free_list);
-            *free_list = (*free_list)->next;
-            return static_cast<T*>(p);
+            large_allocated(bytes_nr);
+            return static_cast<T*>(aligned_new(bytes_nr, alignof(T)));
         }
+        return static_cast<T*>(pool_allocate(bytes_nr));
     }
 
-    static void deallocate(T* p, size_t obj_nr){ 
+    static void deallocate(T* p, size_t obj_nr){
         size_t bytes_nr = obj_nr * sizeof(T);
         if(bytes_nr > MAX_CHUNK_SIZE){
-            ::operator delete(p);
+            large_deallocated(bytes_nr);
+            aligned_delete(p, alignof(T));
+        }else{
+            pool_deallocate(p, bytes_nr);
+        }
+    }
+
+    static T* allocate_batch(size_t obj_nr){
+        if(obj_nr == 0) return nullptr;
+        if(sizeof(T) > MAX_CHUNK_SIZE){
+            PollAllocator alloc;
+            return allocate_each<PollAllocator, T>(alloc, obj_nr);
+        }
+        return static_cast<T*>(pool_allocate_batch(sizeof(T), obj_nr));
+    }
+
+    static void deallocate_batch(T* first, T* last, size_t obj_nr){
+        if(obj_nr == 0) return;
+        if(sizeof(T) > MAX_CHUNK_SIZE){
+            PollAllocator alloc;
+            deallocate_each(alloc, first, obj_nr);
         }else{
-            chunk_node** free_list = get_free_list(bytes_nr);
-            reinterpret_cast<chunk_node*>(p)->next = *free_list;
-            *free_list = reinterpret_cast<chunk_node*>(p);
+            pool_deallocate_batch(first, last, sizeof(T), obj_nr);
+        }
+    }
+};
+
+// Containers hold their allocator by value and ask AllocatorTraits how it
+// travels on copy, move and swap. Allocators without the standard typedefs
+// never propagate and, when empty, always compare equal.
+template <typename ALLOC, typename = void>
+struct allocator_pocca: std::false_type{};
+template <typename ALLOC>
+struct allocator_pocca<ALLOC, std::void_t<typename ALLOC::propagate_on_container_copy_assignment>>:
+    ALLOC::propagate_on_container_copy_assignment{};
+
+template <typename ALLOC, typename = void>
+struct allocator_pocma: std::false_type{};
+template <typename ALLOC>
+struct allocator_pocma<ALLOC, std::void_t<typename ALLOC::propagate_on_container_move_assignment>>:
+    ALLOC::propagate_on_container_move_assignment{};
+
+template <typename ALLOC, typename = void>
+struct allocator_pocs: std::false_type{};
+template <typename ALLOC>
+struct allocator_pocs<ALLOC, std::void_t<typename ALLOC::propagate_on_container_swap>>:
+    ALLOC::propagate_on_container_swap{};
+
+template <typename ALLOC, typename = void>
+struct allocator_always_equal: std::is_empty<ALLOC>{};
+template <typename ALLOC>
+struct allocator_always_equal<ALLOC, std::void_t<typename ALLOC::is_always_equal>>:
+    ALLOC::is_always_equal{};
+
+template <typename ALLOC, typename = void>
+struct allocator_has_select: std::false_type{};
+template <typename ALLOC>
+struct allocator_has_select<ALLOC, std::void_t<decltype(std::declval<const ALLOC&>().select_on_container_copy_construction())>>:
+    std::true_type{};
+
+template <typename ALLOC, typename = void>
+struct allocator_has_batch: std::false_type{};
+template <typename ALLOC>
+struct allocator_has_batch<ALLOC, std::void_t<decltype(std::declval<ALLOC&>().allocate_batch(size_t(1)))>>:
+    std::true_type{};
+
+template <typename ALLOC>
+struct AllocatorTraits{
+    typedef typename std::remove_pointer<decltype(std::declval<ALLOC&>().allocate(size_t(1)))>::type value_type;
+    typedef allocator_pocca<ALLOC> propagate_on_container_copy_assignment;
+    typedef allocator_pocma<ALLOC> propagate_on_container_move_assignment;
+    typedef allocator_pocs<ALLOC> propagate_on_container_swap;
+    typedef allocator_always_equal<ALLOC> is_always_equal;
+
+    static ALLOC select_on_container_copy_construction(const ALLOC& alloc){
+        if constexpr(allocator_has_select<ALLOC>::value) return alloc.select_on_container_copy_construction();
+        else return alloc;
+    }
+
+    static bool equal(const ALLOC& a, const ALLOC& b){
+        if constexpr(is_always_equal::value) return true;
+        else return a == b;
+    }
+
+    static void on_copy_assign(ALLOC& to, const ALLOC& from){
+        if constexpr(propagate_on_container_copy_assignment::value) to = from;
+    }
+
+    static void on_move_assign(ALLOC& to, ALLOC& from){
+        if constexpr(propagate_on_container_move_assignment::value) to = std::move(from);
+    }
+
+    static void on_swap(ALLOC& a, ALLOC& b){
+        if constexpr(propagate_on_container_swap::value){
+            using std::swap;
+            swap(a, b);
         }
     }
+
+    // Falls back to one allocate/deallocate per object for allocators
+    // without a batch interface.
+    template <typename T = value_type>
+    static T* allocate_batch(ALLOC& alloc, size_t obj_nr){
+        if constexpr(allocator_has_batch<ALLOC>::value) return alloc.allocate_batch(obj_nr);
+        else return allocate_each<ALLOC, T>(alloc, obj_nr);
+    }
+
+    template <typename T = value_type>
+    static void deallocate_batch(ALLOC& alloc, T* first, T* last, size_t obj_nr){
+        if constexpr(allocator_has_batch<ALLOC>::value) alloc.deallocate_batch(first, last, obj_nr);
+        else deallocate_each(alloc, first, obj_nr);
+    }
+};
+
+// Containers derive privately from AllocatorHolder so that empty allocators
+// take no space.
+template <typename ALLOC, bool = std::is_empty<ALLOC>::value && !std::is_final<ALLOC>::value>
+class AllocatorHolder: private ALLOC{
+    public:
+        AllocatorHolder() = default;
+        explicit AllocatorHolder(const ALLOC& alloc):ALLOC(alloc){}
+        explicit AllocatorHolder(ALLOC&& alloc):ALLOC(std::move(alloc)){}
+
+        ALLOC& alloc(){ return *this;}
+        const ALLOC& alloc() const{ return *this;}
+};
+
+template <typename ALLOC>
+class AllocatorHolder<ALLOC, false>{
+    private:
+        ALLOC alloc_;
+    public:
+        AllocatorHolder() = default;
+        explicit AllocatorHolder(const ALLOC& alloc):alloc_(alloc){}
+        explicit AllocatorHolder(ALLOC&& alloc):alloc_(std::move(alloc)){}
+
+        ALLOC& alloc(){ return alloc_;}
+        const ALLOC& alloc() const{ return alloc_;}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,110 @@
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <algorithm>
+
+// Hands out memory by bumping a pointer, first through an optional caller
+// buffer and then through blocks that double in size. Nothing is freed until
+// release() or the arena's destruction.
+class MonotonicArena{
+    public:
+        enum{ MIN_BLOCK_SIZE = 1024 };
+    private:
+        struct block{
+            block* next;
+            size_t size;
+        };
+        char* cur_;
+        char* end_;
+        block* blocks_;
+        size_t next_block_size_;
+        char* initial_buffer_;
+        size_t initial_size_;
+
+        static char* align_up(char* p, size_t align){
+            return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + align - 1) & ~(uintptr_t(align) - 1));
+        }
+
+        void grow(size_t bytes_nr, size_t align){
+            size_t size = std::max(next_block_size_, bytes_nr + align + sizeof(block));
+            block* b = static_cast<block*>(::operator new(size));
+            b->next = blocks_;
+            b->size = size;
+            blocks_ = b;
+            cur_ = reinterpret_cast<char*>(b + 1);
+            end_ = reinterpret_cast<char*>(b) + size;
+            next_block_size_ = size * 2;
+        }
+
+    public:
+        MonotonicArena():cur_(nullptr), end_(nullptr), blocks_(nullptr), next_block_size_(MIN_BLOCK_SIZE),
+                         initial_buffer_(nullptr), initial_size_(0){}
+
+        explicit MonotonicArena(size_t initial_block_size):MonotonicArena(){
+            next_block_size_ = std::max(initial_block_size, size_t(MIN_BLOCK_SIZE));
+        }
+
+        MonotonicArena(void* buffer, size_t size):cur_(static_cast<char*>(buffer)), end_(static_cast<char*>(buffer) + size),
+                       blocks_(nullptr), next_block_size_(std::max(size * 2, size_t(MIN_BLOCK_SIZE))),
+                       initial_buffer_(static_cast<char*>(buffer)), initial_size_(size){}
+
+        MonotonicArena(const MonotonicArena&) = delete;
+        MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+        ~MonotonicArena(){
+            release();
+        }
+
+        void* allocate(size_t bytes_nr, size_t align = alignof(std::max_align_t)){
+            char* p = align_up(cur_, align);
+            if(cur_ == nullptr || p > end_ || size_t(end_ - p) < bytes_nr){
+                grow(bytes_nr, align);
+                p = align_up(cur_, align);
+            }
+            cur_ = p + bytes_nr;
+            return p;
+        }
+
+        void deallocate(void*, size_t){}
+
+        // Frees every block and starts over from the caller buffer, if any.
+        void release(){
+            while(blocks_ != nullptr){
+                block* b = blocks_;
+                blocks_ = b->next;
+                ::operator delete(b);
+            }
+            cur_ = initial_buffer_;
+            end_ = initial_buffer_ + initial_size_;
+        }
+};
+
+template <typename T>
+class ArenaAllocator{
+    public:
+        typedef T value_type;
+
+        template <typename U>
+        friend class ArenaAllocator;
+
+        explicit ArenaAllocator(MonotonicArena* arena):arena_(arena){}
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other):arena_(other.arena_){}
+
+        T* allocate(size_t obj_nr, void* = static_cast<void*>(nullptr)){
+            return static_cast<T*>(arena_->allocate(obj_nr * sizeof(T), alignof(T)));
+        }
+        void deallocate(T*, size_t){}
+
+        MonotonicArena* arena() const{ return arena_;}
+
+        bool operator==(const ArenaAllocator& other) const{ return arena_ == other.arena_;}
+        bool operator!=(const ArenaAllocator& other) const{ return arena_ != other.arena_;}
+    private:
+        MonotonicArena* arena_;
+};
+
+#endif
\ No newline at end of file
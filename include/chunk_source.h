@@ -0,0 +1,215 @@
+#ifndef __CHUNK_SOURCE_H
+#define __CHUNK_SOURCE_H
+
+#include <cstddef>
+#include <algorithm>
+#include <new>
+#include <mutex>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+// A chunk source hands PoolAllocatorBase the raw memory it carves size
+// classes from. Both functions follow the allocator shape, but allocate
+// returns nullptr instead of throwing.
+struct ChunkSource{
+    void* (*allocate)(size_t bytes_nr);
+    void (*deallocate)(void* p, size_t bytes_nr);
+};
+
+class NewChunkSource{
+    public:
+        static void* allocate(size_t bytes_nr){
+            return ::operator new(bytes_nr, std::nothrow);
+        }
+        static void deallocate(void* p, size_t){
+            ::operator delete(p);
+        }
+};
+
+// Reserves REGION_SIZE regions with mmap and carves chunks out of them, so the
+// pool lives in a few large, huge-page friendly mappings. Freed chunks go on
+// their region's extent list and are reused before a new region is mapped;
+// a region is unmapped once every chunk carved from it has been given back.
+class MmapChunkSource{
+    public:
+        enum HugePageMode{ HUGE_PAGE_NONE, HUGE_PAGE_MADVISE, HUGE_PAGE_HUGETLB };
+        enum{ HUGE_PAGE_SIZE = 2 << 20 };
+        enum{ REGION_SIZE = 64 << 20 };
+        enum{ CHUNK_ALIGN = 64 };
+    private:
+        // A freed range inside a region, kept in the range itself.
+        struct extent{
+            extent* next;
+            size_t size;
+        };
+        struct region{
+            region* next;
+            extent* free;   // sorted by address, none touching used
+            size_t size;
+            size_t used;
+            size_t live;
+            bool huge_tlb;
+        };
+        static region* regions_;
+        static HugePageMode mode_;
+        static std::mutex lock_;
+
+        static size_t round_up(size_t n, size_t align){
+            return (n + align - 1) & ~(align - 1);
+        }
+
+        static void unmap(region* r){
+            ::munmap(r, r->size);
+        }
+
+        static region* map_region(size_t bytes_nr){
+            size_t size = round_up(bytes_nr + round_up(sizeof(region), CHUNK_ALIGN), HUGE_PAGE_SIZE);
+            size = std::max(size, size_t(REGION_SIZE));
+            void* p = MAP_FAILED;
+            bool huge_tlb = false;
+#ifdef MAP_HUGETLB
+            if(mode_ == HUGE_PAGE_HUGETLB){
+                p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                huge_tlb = (p != MAP_FAILED);
+            }
+#endif
+            if(p == MAP_FAILED){
+                // Over-reserve so the region can start on a huge page boundary.
+                size_t reserve = size + HUGE_PAGE_SIZE;
+                char* raw = static_cast<char*>(::mmap(nullptr, reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+                if(raw == MAP_FAILED) return nullptr;
+                char* aligned = reinterpret_cast<char*>(round_up(reinterpret_cast<size_t>(raw), HUGE_PAGE_SIZE));
+                if(aligned != raw) ::munmap(raw, aligned - raw);
+                if(aligned + size != raw + reserve) ::munmap(aligned + size, raw + reserve - (aligned + size));
+                p = aligned;
+#ifdef MADV_HUGEPAGE
+                if(mode_ != HUGE_PAGE_NONE) ::madvise(p, size, MADV_HUGEPAGE);
+#endif
+            }
+            region* r = static_cast<region*>(p);
+            r->next = regions_;
+            r->free = nullptr;
+            r->size = size;
+            r->used = round_up(sizeof(region), CHUNK_ALIGN);
+            r->live = 0;
+            r->huge_tlb = huge_tlb;
+            regions_ = r;
+            return r;
+        }
+
+        // First fit over the freed extents, then the untouched tail.
+        static char* carve(region* r, size_t bytes_nr){
+            for(extent** link = &r->free; *link != nullptr; link = &(*link)->next){
+                extent* e = *link;
+                if(e->size < bytes_nr) continue;
+                if(e->size == bytes_nr){
+                    *link = e->next;
+                }else{
+                    extent* rest = reinterpret_cast<extent*>(reinterpret_cast<char*>(e) + bytes_nr);
+                    rest->next = e->next;
+                    rest->size = e->size - bytes_nr;
+                    *link = rest;
+                }
+                return reinterpret_cast<char*>(e);
+            }
+            if(r->size - r->used < bytes_nr) return nullptr;
+            char* p = reinterpret_cast<char*>(r) + r->used;
+            r->used += bytes_nr;
+            return p;
+        }
+
+        // Puts [p, p + bytes_nr) back, merging it with its neighbours. An
+        // extent that reaches the tail is handed back to the bump pointer.
+        static void release(region* r, char* p, size_t bytes_nr){
+            extent** link = &r->free;
+            extent** prev_link = nullptr;
+            while(*link != nullptr && reinterpret_cast<char*>(*link) < p){
+                prev_link = link;
+                link = &(*link)->next;
+            }
+            if(prev_link != nullptr && reinterpret_cast<char*>(*prev_link) + (*prev_link)->size == p){
+                link = prev_link;
+                (*link)->size += bytes_nr;
+            }else{
+                extent* e = reinterpret_cast<extent*>(p);
+                e->next = *link;
+                e->size = bytes_nr;
+                *link = e;
+            }
+            extent* e = *link;
+            if(e->next != nullptr && reinterpret_cast<char*>(e) + e->size == reinterpret_cast<char*>(e->next)){
+                e->size += e->next->size;
+                e->next = e->next->next;
+            }
+            if(reinterpret_cast<char*>(e) + e->size == reinterpret_cast<char*>(r) + r->used){
+                r->used -= e->size;
+                *link = nullptr;
+            }
+        }
+
+    public:
+        static void set_huge_pages(HugePageMode mode){
+            std::lock_guard<std::mutex> guard(lock_);
+            mode_ = mode;
+        }
+
+        static void* allocate(size_t bytes_nr){
+            std::lock_guard<std::mutex> guard(lock_);
+            bytes_nr = round_up(bytes_nr, CHUNK_ALIGN);
+            for(region* r = regions_; r != nullptr; r = r->next){
+                if(char* p = carve(r, bytes_nr)){
+                    r->live += bytes_nr;
+                    return p;
+                }
+            }
+            region* r = map_region(bytes_nr);
+            if(r == nullptr) return nullptr;
+            r->live += bytes_nr;
+            return carve(r, bytes_nr);
+        }
+
+        // Regions are few and large, so a linear search is cheap; the region
+        // found moves to the front, where allocate looks first.
+        static void deallocate(void* p, size_t bytes_nr){
+            std::lock_guard<std::mutex> guard(lock_);
+            bytes_nr = round_up(bytes_nr, CHUNK_ALIGN);
+            region** link = &regions_;
+            while(*link != nullptr){
+                region* r = *link;
+                char* first = reinterpret_cast<char*>(r);
+                if(static_cast<char*>(p) >= first && static_cast<char*>(p) < first + r->size){
+                    *link = r->next;
+                    r->live -= bytes_nr;
+                    if(r->live == 0){
+                        unmap(r);
+                        return;
+                    }
+                    if(!r->huge_tlb){
+                        // Give the pages strictly inside the chunk back now;
+                        // the extent header is written after.
+                        size_t page = ::sysconf(_SC_PAGESIZE);
+                        char* begin = reinterpret_cast<char*>(round_up(reinterpret_cast<size_t>(p), page));
+                        char* end = reinterpret_cast<char*>((reinterpret_cast<size_t>(p) + bytes_nr) & ~(page - 1));
+                        if(begin < end) ::madvise(begin, end - begin, MADV_DONTNEED);
+                    }
+                    release(r, static_cast<char*>(p), bytes_nr);
+                    r->next = regions_;
+                    regions_ = r;
+                    return;
+                }
+                link = &r->next;
+            }
+        }
+};
+
+MmapChunkSource::region* MmapChunkSource::regions_ = nullptr;
+MmapChunkSource::HugePageMode MmapChunkSource::mode_ = MmapChunkSource::HUGE_PAGE_MADVISE;
+std::mutex MmapChunkSource::lock_;
+
+template <typename SOURCE>
+constexpr ChunkSource make_chunk_source(){
+    return ChunkSource{ &SOURCE::allocate, &SOURCE::deallocate };
+}
+
+#endif
\ No newline at end of file
@@ -2,12 +2,42 @@
 #define __DEQUE_H
 
 #include <memory>
+#include <iterator>
+#include <numeric>
 
 #include "allocator.h"
+#include "relocate.h"
 
+// Default block size in bytes; Deque's BLOCK_BYTES parameter overrides it.
+#ifndef DEQUE_BUFFER_SIZE
 #define DEQUE_BUFFER_SIZE 512
+#endif
+
+// Large elements still get this many per block.
+#ifndef DEQUE_MIN_BLOCK_ELEMENTS
+#define DEQUE_MIN_BLOCK_ELEMENTS 8
+#endif
+
+// Emptied blocks a Deque keeps for reuse at either end, so a queue that
+// stays about the same length stops going to the allocator.
+#ifndef DEQUE_SPARE_BLOCKS
+#define DEQUE_SPARE_BLOCKS 2
+#endif
+
+// Elements per block: BYTES worth of T rounded down to a power of two, so
+// index arithmetic is shifts and masks.
+template <typename T, size_t BYTES>
+struct DequeBlock{
+    static constexpr size_t floor_pow2(size_t n){ return n < 2 ? 1 : 2 * floor_pow2(n / 2);}
+    static constexpr size_t log2(size_t n){ return n < 2 ? 0 : 1 + log2(n / 2);}
+
+    static constexpr size_t SIZE = std::max(floor_pow2(BYTES / sizeof(T)), size_t(DEQUE_MIN_BLOCK_ELEMENTS));
+    static constexpr size_t SHIFT = log2(SIZE);
+    static constexpr size_t MASK = SIZE - 1;
+    static_assert((DEQUE_MIN_BLOCK_ELEMENTS & (DEQUE_MIN_BLOCK_ELEMENTS - 1)) == 0, "DEQUE_MIN_BLOCK_ELEMENTS must be a power of two");
+};
 
-template <typename T>
+template <typename T, size_t BLOCK_SIZE = DequeBlock<T, DEQUE_BUFFER_SIZE>::SIZE>
 struct DequeIterator{
     typedef std::random_access_iterator_tag    iterator_category;
     typedef T        value_type;
@@ -28,13 +58,10 @@ struct DequeIterator{
 
     DequeIterator(map_pointer pnode, pointer cur):pnode_(pnode), cur_(cur), first_(*pnode), last_(first_ + buffer_size()){}
 
-    static inline size_type buffer_size(){
-        if(sizeof(T) < DEQUE_BUFFER_SIZE){
-            return DEQUE_BUFFER_SIZE / sizeof(T);
-        }else{
-            return 1;
-        }
-    }
+    static_assert((BLOCK_SIZE & (BLOCK_SIZE - 1)) == 0, "block size must be a power of two");
+    enum{ SHIFT = DequeBlock<T, 1>::log2(BLOCK_SIZE) };
+
+    static constexpr size_type buffer_size(){ return BLOCK_SIZE;}
 
     void set_node(map_pointer pnode){
         pnode_ = pnode;
@@ -42,7 +69,7 @@ struct DequeIterator{
         last_ = first_ + buffer_size();
     }
 
-    reference operator *(){
+    reference operator *() const{
         return *cur_;
     }
 
@@ -81,14 +108,14 @@ struct DequeIterator{
         if(diff >= 0 && diff < difference_type(buffer_size())){
             cur_ += off;
         }else{
-            difference_type node_diff = (diff > 0)? (diff / buffer_size()) : (-((-diff - 1) / buffer_size()) - 1);
-            set_node(pnode_ + node_diff);
-            cur_ = first_ + (diff - node_diff * buffer_size());
+            // Arithmetic shift rounds towards minus infinity, as needed here.
+            set_node(pnode_ + (diff >> SHIFT));
+            cur_ = first_ + (diff & difference_type(BLOCK_SIZE - 1));
         }
         return *this;
     }
 
-    self operator+(difference_type off){
+    self operator+(difference_type off) const{
         self tmp = *this;
         tmp += off;
         return tmp;
@@ -98,14 +125,18 @@ struct DequeIterator{
         return (*this) += -off;
     }
 
-    self operator-(difference_type off){
+    self operator-(difference_type off) const{
         self tmp = *this;
         tmp -= off;
         return tmp;
     }
 
+    reference operator[](difference_type off) const{
+        return *(*this + off);
+    }
+
     difference_type operator-(const self& other) const{
-        return (pnode_-other.pnode_) * buffer_size() + ((cur_ - first_)  - (other.cur_ - other.first_));
+        return (pnode_ - other.pnode_) * difference_type(BLOCK_SIZE) + ((cur_ - first_)  - (other.cur_ - other.first_));
     }
 
     bool operator==(const self& other) const{
@@ -136,8 +167,198 @@ struct DequeIterator{
 };
 
 
-template <typename T, template<typename N> typename ALLOC = NewAllocator>
-class Deque{
+template <typename IT>
+struct is_deque_iterator: std::false_type{};
+template <typename T, size_t BLOCK_SIZE>
+struct is_deque_iterator<DequeIterator<T, BLOCK_SIZE>>: std::true_type{};
+
+// Segmented algorithms: a Deque range is a run of contiguous blocks, so these
+// work block by block on raw pointers instead of paying for the node check
+// in every DequeIterator::operator++. They accept other iterators too and
+// fall back to the std algorithm for them.
+
+// Calls fn(begin, end) on each contiguous piece of [first, last).
+template <typename T, size_t BLOCK_SIZE, typename FN>
+inline void for_each_segment(DequeIterator<T, BLOCK_SIZE> first, DequeIterator<T, BLOCK_SIZE> last, FN&& fn){
+    if(first.pnode_ == last.pnode_){
+        fn(first.cur_, last.cur_);
+        return;
+    }
+    fn(first.cur_, first.last_);
+    for(T** node = first.pnode_ + 1; node != last.pnode_; ++node) fn(*node, *node + BLOCK_SIZE);
+    fn(last.first_, last.cur_);
+}
+
+// Applies op(src, src_end, dst) -> dst_end to pieces that are contiguous in
+// both ranges, advancing d_first as it goes. Pieces are visited front to
+// back, so the ranges may overlap when d_first precedes first.
+template <typename InputIt, typename OutputIt, typename OP>
+inline void segment_transfer(InputIt first, InputIt last, OutputIt& d_first, OP op){
+    typedef typename std::iterator_traits<InputIt>::iterator_category category;
+    if constexpr(is_deque_iterator<InputIt>::value){
+        for_each_segment(first, last, [&](auto b, auto e){ segment_transfer(b, e, d_first, op);});
+    }else if constexpr(is_deque_iterator<OutputIt>::value && std::is_base_of<std::random_access_iterator_tag, category>::value){
+        typedef typename OutputIt::difference_type difference_type;
+        difference_type n = last - first;
+        while(n > 0){
+            difference_type step = std::min(n, difference_type(d_first.last_ - d_first.cur_));
+            op(first, first + step, d_first.cur_);
+            first += step;
+            d_first += step;
+            n -= step;
+        }
+    }else{
+        d_first = op(first, last, d_first);
+    }
+}
+
+// The same walk back to front, for op(src, src_end, dst_end) -> dst; the
+// ranges may overlap when d_last follows last.
+template <typename T, size_t BLOCK_SIZE, typename OP>
+inline void segment_transfer_backward(DequeIterator<T, BLOCK_SIZE> first, DequeIterator<T, BLOCK_SIZE> last,
+                                      DequeIterator<T, BLOCK_SIZE> d_last, OP op){
+    typedef ptrdiff_t difference_type;
+    difference_type n = last - first;
+    while(n > 0){
+        difference_type src = (last.cur_ == last.first_)? difference_type(BLOCK_SIZE) : last.cur_ - last.first_;
+        difference_type dst = (d_last.cur_ == d_last.first_)? difference_type(BLOCK_SIZE) : d_last.cur_ - d_last.first_;
+        difference_type step = std::min({n, src, dst});
+        last -= step;
+        d_last -= step;
+        op(last.cur_, last.cur_ + step, d_last.cur_ + step);
+        n -= step;
+    }
+}
+
+template <typename InputIt, typename UnaryFunction>
+UnaryFunction segmented_for_each(InputIt first, InputIt last, UnaryFunction f){
+    if constexpr(is_deque_iterator<InputIt>::value){
+        for_each_segment(first, last, [&](auto b, auto e){ for(; b != e; ++b) f(*b);});
+        return f;
+    }else{
+        return std::for_each(first, last, f);
+    }
+}
+
+template <typename InputIt, typename T, typename BinaryOp>
+T segmented_accumulate(InputIt first, InputIt last, T init, BinaryOp op){
+    if constexpr(is_deque_iterator<InputIt>::value){
+        for_each_segment(first, last, [&](auto b, auto e){ init = std::accumulate(b, e, std::move(init), op);});
+        return init;
+    }else{
+        return std::accumulate(first, last, std::move(init), op);
+    }
+}
+
+template <typename InputIt, typename T>
+T segmented_accumulate(InputIt first, InputIt last, T init){
+    return segmented_accumulate(first, last, std::move(init), std::plus<>());
+}
+
+template <typename InputIt, typename T>
+InputIt segmented_find(InputIt first, InputIt last, const T& value){
+    if constexpr(is_deque_iterator<InputIt>::value){
+        while(first.pnode_ != last.pnode_){
+            auto p = std::find(first.cur_, first.last_, value);
+            if(p != first.last_){
+                first.cur_ = p;
+                return first;
+            }
+            first.set_node(first.pnode_ + 1);
+            first.cur_ = first.first_;
+        }
+        first.cur_ = std::find(first.cur_, last.cur_, value);
+        return first;
+    }else{
+        return std::find(first, last, value);
+    }
+}
+
+template <typename ForwardIt, typename T>
+void segmented_fill(ForwardIt first, ForwardIt last, const T& value){
+    if constexpr(is_deque_iterator<ForwardIt>::value){
+        for_each_segment(first, last, [&](auto b, auto e){ std::fill(b, e, value);});
+    }else{
+        std::fill(first, last, value);
+    }
+}
+
+template <typename InputIt, typename OutputIt>
+OutputIt segmented_copy(InputIt first, InputIt last, OutputIt d_first){
+    segment_transfer(first, last, d_first, [](auto b, auto e, auto d){ return std::copy(b, e, d);});
+    return d_first;
+}
+
+template <typename InputIt, typename OutputIt>
+OutputIt segmented_move(InputIt first, InputIt last, OutputIt d_first){
+    segment_transfer(first, last, d_first, [](auto b, auto e, auto d){ return std::move(b, e, d);});
+    return d_first;
+}
+
+template <typename BidirIt1, typename BidirIt2>
+BidirIt2 segmented_move_backward(BidirIt1 first, BidirIt1 last, BidirIt2 d_last){
+    if constexpr(is_deque_iterator<BidirIt1>::value && std::is_same<BidirIt1, BidirIt2>::value){
+        segment_transfer_backward(first, last, d_last, [](auto b, auto e, auto d){ return std::move_backward(b, e, d);});
+        return d_last - (last - first);
+    }else{
+        return std::move_backward(first, last, d_last);
+    }
+}
+
+template <typename ForwardIt>
+void segmented_destroy(ForwardIt first, ForwardIt last){
+    if constexpr(is_deque_iterator<ForwardIt>::value){
+        for_each_segment(first, last, [](auto b, auto e){ std::destroy(b, e);});
+    }else{
+        std::destroy(first, last);
+    }
+}
+
+// If a constructor throws, the elements already built are destroyed.
+template <typename InputIt, typename ForwardIt>
+ForwardIt segmented_uninitialized_copy(InputIt first, InputIt last, ForwardIt d_first){
+    ForwardIt cur = d_first;
+    try{
+        segment_transfer(first, last, cur, [](auto b, auto e, auto d){ return std::uninitialized_copy(b, e, d);});
+    }catch(...){
+        segmented_destroy(d_first, cur);
+        throw;
+    }
+    return cur;
+}
+
+template <typename InputIt, typename ForwardIt>
+ForwardIt segmented_uninitialized_move(InputIt first, InputIt last, ForwardIt d_first){
+    ForwardIt cur = d_first;
+    try{
+        segment_transfer(first, last, cur, [](auto b, auto e, auto d){ return std::uninitialized_move(b, e, d);});
+    }catch(...){
+        segmented_destroy(d_first, cur);
+        throw;
+    }
+    return cur;
+}
+
+template <typename ForwardIt, typename T>
+void segmented_uninitialized_fill(ForwardIt first, ForwardIt last, const T& value){
+    if constexpr(is_deque_iterator<ForwardIt>::value){
+        ForwardIt done = first;
+        try{
+            for_each_segment(first, last, [&](auto b, auto e){
+                std::uninitialized_fill(b, e, value);
+                done += e - b;
+            });
+        }catch(...){
+            segmented_destroy(first, done);
+            throw;
+        }
+    }else{
+        std::uninitialized_fill(first, last, value);
+    }
+}
+
+template <typename T, template<typename N> typename ALLOC = NewAllocator, size_t BLOCK_BYTES = DEQUE_BUFFER_SIZE>
+class Deque: private AllocatorHolder<ALLOC<T>>{
     public:
     typedef T       value_type;
     typedef T*      pointer;
@@ -145,26 +366,58 @@ class Deque{
     typedef size_t  size_type;
     typedef const value_type& const_reference;
 
-    typedef DequeIterator<T> iterator;
+    typedef DequeBlock<T, BLOCK_BYTES> block;
+    typedef DequeIterator<T, block::SIZE> iterator;
     typedef typename iterator::map_pointer map_pointer;
     typedef ALLOC<pointer> MAP_ALLOC;
     typedef ALLOC<value_type> BUFFER_ALLOC;
+    typedef BUFFER_ALLOC allocator_type;
+    typedef AllocatorTraits<BUFFER_ALLOC> alloc_traits;
     typedef ptrdiff_t difference_type;
 
 
     private:
+    typedef AllocatorHolder<BUFFER_ALLOC> holder;
+    using holder::alloc;
+
     iterator begin_;
     iterator end_;
     map_pointer map_;
     size_type map_size_;
+    pointer spare_[DEQUE_SPARE_BLOCKS > 0 ? DEQUE_SPARE_BLOCKS : 1] = {};
+    size_type spare_nr_ = 0;
 
-    static inline size_type buffer_size(){ return (sizeof(T) < DEQUE_BUFFER_SIZE)?(DEQUE_BUFFER_SIZE / sizeof(T)):1;}
-    pointer buffer_allocate(){ return BUFFER_ALLOC::allocate(buffer_size());}
+    // The map allocator is rebound from the buffer allocator when it can be.
+    MAP_ALLOC map_alloc() const{
+        if constexpr(std::is_constructible<MAP_ALLOC, const BUFFER_ALLOC&>::value) return MAP_ALLOC(alloc());
+        else return MAP_ALLOC();
+    }
+
+    static constexpr size_type buffer_size(){ return block::SIZE;}
+    pointer buffer_allocate(){
+        if(spare_nr_ > 0) return spare_[--spare_nr_];
+        return alloc().allocate(buffer_size());
+    }
     void buffer_allocate_n(map_pointer first, map_pointer last){ while(first != last) (*first++) = buffer_allocate();}
-    void buffer_deallocate(map_pointer p){ return BUFFER_ALLOC::deallocate(*p, buffer_size());}
+    void buffer_deallocate(map_pointer p){
+        if(spare_nr_ < DEQUE_SPARE_BLOCKS) spare_[spare_nr_++] = *p;
+        else alloc().deallocate(*p, buffer_size());
+    }
+    void release_spares(){
+        while(spare_nr_ > 0) alloc().deallocate(spare_[--spare_nr_], buffer_size());
+    }
     void buffer_deallocate_n(map_pointer first, map_pointer last){ while(first != last) buffer_deallocate(first++); }
-    map_pointer map_allocate(size_type n){ return MAP_ALLOC::allocate(n);}
-    void map_deallocate(){ return MAP_ALLOC::deallocate(map_, map_size_);}
+    map_pointer map_allocate(size_type n){ return map_alloc().allocate(n);}
+    void map_deallocate(){ return map_alloc().deallocate(map_, map_size_);}
+
+    void swap_storage(Deque& other){
+        std::swap(begin_, other.begin_);
+        std::swap(end_, other.end_);
+        std::swap(map_, other.map_);
+        std::swap(map_size_, other.map_size_);
+        std::swap(spare_, other.spare_);
+        std::swap(spare_nr_, other.spare_nr_);
+    }
 
     void reallocate_map(size_type n, bool is_front){
         size_type new_node_nr = n + (end_.pnode_ - begin_.pnode_ + 1);
@@ -172,18 +425,14 @@ class Deque{
         if(map_size_ > new_node_nr){
             map_pointer new_start = map_ + (map_size_ - new_node_nr) / 2 + (is_front?n:0);
             if(new_start == old_start) return;
-            if(new_start < old_start){
-                std::copy(old_start, old_finish + 1, new_start);
-            }else{
-                std::copy_backward(old_start, old_finish + 1, new_start + (old_finish - old_start) + 1);
-            }
+            std::memmove(new_start, old_start, (old_finish - old_start + 1) * sizeof(pointer));
             begin_.set_node(new_start);
             end_.set_node(new_start + (old_finish - old_start));
         }else{
             size_type new_cap = std::max(2 * map_size_, new_node_nr);
             map_pointer new_map = map_allocate(new_cap);
             map_pointer new_start = new_map +  (new_cap - new_node_nr) / 2 + (is_front?n:0);
-            std::copy(old_start, old_finish + 1, new_start);
+            std::memcpy(new_start, old_start, (old_finish - old_start + 1) * sizeof(pointer));
             map_deallocate();
             map_ = new_map;
             map_size_ = new_cap;
@@ -192,6 +441,23 @@ class Deque{
         }
     }
 
+    // Byte-wise moves for trivially relocatable elements. relocate_forward
+    // may overlap when d_first precedes first, relocate_backward when d_last
+    // follows last.
+    static void relocate_forward(iterator first, iterator last, iterator d_first){
+        segment_transfer(first, last, d_first, [](pointer b, pointer e, pointer d){
+            std::memmove(static_cast<void*>(d), static_cast<const void*>(b), (e - b) * sizeof(T));
+            return d + (e - b);
+        });
+    }
+
+    static void relocate_backward(iterator first, iterator last, iterator d_last){
+        segment_transfer_backward(first, last, d_last, [](pointer b, pointer e, pointer d){
+            std::memmove(static_cast<void*>(d - (e - b)), static_cast<const void*>(b), (e - b) * sizeof(T));
+            return d - (e - b);
+        });
+    }
+
     void reserve_front(size_type count){
         if(size_type(begin_.pnode_ - map_) < count)
             reallocate_map(count, true);
@@ -202,27 +468,124 @@ class Deque{
             reallocate_map(count, false);
     }
 
-    void reserve_n(iterator pos, size_type count){
-        size_type front_elem_nr =  size_type(pos - begin_);
-        if(front_elem_nr < size() / 2){
-            difference_type diff = count - (begin_.cur_ - begin_.first_);
-            size_type new_node_nr = (diff + buffer_size() - 1) / buffer_size();
+    // Makes sure the blocks holding the count slots before begin_ (or after
+    // end_) exist and returns the iterator to the new first (or past-the-end)
+    // slot. The blocks are given back by release_front/release_back.
+    iterator grow_front(size_type count){
+        difference_type room = begin_.cur_ - begin_.first_;
+        if(difference_type(count) > room){
+            size_type new_node_nr = (count - room + buffer_size() - 1) / buffer_size();
             reserve_front(new_node_nr);
             buffer_allocate_n(begin_.pnode_ - new_node_nr, begin_.pnode_);
-            iterator old_begin = begin_;
-            std::uninitialized_copy_n(begin_, count, begin_ - difference_type(count));
-            std::move(old_begin + difference_type(count), old_begin + difference_type(front_elem_nr), old_begin);
-            begin_ = begin_ - difference_type(count);
-        }else{
-            difference_type diff = count - (end_.last_ - end_.cur_ - 1);
-            size_type new_node_nr = (diff + buffer_size() - 1) / buffer_size();
+        }
+        return begin_ - difference_type(count);
+    }
+
+    iterator grow_back(size_type count){
+        difference_type room = end_.last_ - end_.cur_ - 1;
+        if(difference_type(count) > room){
+            size_type new_node_nr = (count - room + buffer_size() - 1) / buffer_size();
             reserve_back(new_node_nr);
             buffer_allocate_n(end_.pnode_ + 1, end_.pnode_ + 1 + new_node_nr);
+        }
+        return end_ + difference_type(count);
+    }
+
+    void release_front(iterator new_begin){ buffer_deallocate_n(new_begin.pnode_, begin_.pnode_);}
+    void release_back(iterator new_end){ buffer_deallocate_n(end_.pnode_ + 1, new_end.pnode_ + 1);}
+
+    // Opens count slots before the element at index front_elem_nr by moving
+    // the shorter side outwards, then hands the gap to
+    // fill(first, last, offset, raw): offset is the index of first within
+    // the gap and raw says [first, last) still has to be constructed rather
+    // than assigned. Slots past the old ends are raw; the rest hold
+    // moved-from elements. If constructing throws, the Deque is unchanged.
+    template <typename FILL>
+    iterator insert_gap(size_type front_elem_nr, size_type count, FILL fill){
+        if(count == 0) return begin_ + front_elem_nr;
+        size_type back_elem_nr = size() - front_elem_nr;
+        if(front_elem_nr < back_elem_nr){
+            iterator new_begin = grow_front(count);
+            iterator pos = begin_ + front_elem_nr;
+            try{
+                if(count <= front_elem_nr){
+                    segmented_uninitialized_move(begin_, begin_ + difference_type(count), new_begin);
+                }else{
+                    fill(new_begin + front_elem_nr, begin_, 0, true);
+                    try{
+                        segmented_uninitialized_move(begin_, pos, new_begin);
+                    }catch(...){
+                        segmented_destroy(new_begin + front_elem_nr, begin_);
+                        throw;
+                    }
+                }
+            }catch(...){
+                release_front(new_begin);
+                throw;
+            }
+            iterator old_begin = begin_;
+            begin_ = new_begin;
+            if(count <= front_elem_nr){
+                segmented_move(old_begin + difference_type(count), pos, old_begin);
+                fill(pos - difference_type(count), pos, 0, false);
+            }else{
+                fill(old_begin, pos, count - front_elem_nr, false);
+            }
+        }else{
+            iterator new_end = grow_back(count);
+            iterator pos = begin_ + front_elem_nr;
+            try{
+                if(count <= back_elem_nr){
+                    segmented_uninitialized_move(end_ - difference_type(count), end_, end_);
+                }else{
+                    fill(end_, pos + difference_type(count), back_elem_nr, true);
+                    try{
+                        segmented_uninitialized_move(pos, end_, pos + difference_type(count));
+                    }catch(...){
+                        segmented_destroy(end_, pos + difference_type(count));
+                        throw;
+                    }
+                }
+            }catch(...){
+                release_back(new_end);
+                throw;
+            }
             iterator old_end = end_;
-            std::uninitialized_copy_n(end_ - difference_type(count), count, end_);
-            std::move_backward(begin_ + difference_type(front_elem_nr), old_end - difference_type(count), old_end);
-            end_ = end_ + difference_type(count);
+            end_ = new_end;
+            if(count <= back_elem_nr){
+                segmented_move_backward(pos, old_end - difference_type(count), old_end);
+                fill(pos, pos + difference_type(count), 0, false);
+            }else{
+                fill(pos, old_end, 0, false);
+            }
         }
+        return begin_ + front_elem_nr;
+    }
+
+    template <typename... Args>
+    __attribute__((noinline, cold)) void emplace_front_aux(Args&&... args){
+        reserve_front(1);
+        *(begin_.pnode_ - 1) = buffer_allocate();
+        try{
+            ::new(static_cast<void*>(*(begin_.pnode_ - 1) + buffer_size() - 1)) T(std::forward<Args>(args)...);
+        }catch(...){
+            buffer_deallocate(begin_.pnode_ - 1);
+            throw;
+        }
+        --begin_;
+    }
+
+    template <typename... Args>
+    __attribute__((noinline, cold)) void emplace_back_aux(Args&&... args){
+        reserve_back(1);
+        *(end_.pnode_ + 1) = buffer_allocate();
+        try{
+            ::new(static_cast<void*>(end_.cur_)) T(std::forward<Args>(args)...);
+        }catch(...){
+            buffer_deallocate(end_.pnode_ + 1);
+            throw;
+        }
+        ++end_;
     }
 
     void map_init(size_type n){
@@ -237,118 +600,240 @@ class Deque{
         end_ = begin_ + n;
     }
 
+    // Frees the blocks and map of a constructor that failed part way; the
+    // elements must already be destroyed.
+    void init_failed(){
+        buffer_deallocate_n(begin_.pnode_, end_.pnode_ + 1);
+        map_deallocate();
+        release_spares();
+    }
+
     void fill_init(size_type n, value_type value = value_type()){
         map_init(n);
-        std::uninitialized_fill(begin_, end_, value);
+        try{
+            segmented_uninitialized_fill(begin_, end_, value);
+        }catch(...){
+            init_failed();
+            throw;
+        }
     }
 
+    // Forward ranges are measured and built in place; input ranges are
+    // appended one element at a time.
     template< class InputIt >
     void copy_init(InputIt first, InputIt last){
-        size_type n = std::distance(first, last);
-        map_init(n);
-        std::uninitialized_copy(first, last, begin_);
+        typedef typename std::iterator_traits<InputIt>::iterator_category category;
+        if constexpr(std::is_base_of<std::forward_iterator_tag, category>::value){
+            size_type n = std::distance(first, last);
+            map_init(n);
+            try{
+                segmented_uninitialized_copy(first, last, begin_);
+            }catch(...){
+                init_failed();
+                throw;
+            }
+        }else{
+            map_init(0);
+            try{
+                for(; first != last; ++first) emplace_back(*first);
+            }catch(...){
+                segmented_destroy(begin_, end_);
+                init_failed();
+                throw;
+            }
+        }
     }
 
 public:
-    Deque(){ fill_init(0);}
+    Deque(){ map_init(0);}
 
-    Deque( size_type count, const_reference value = T()){ fill_init(count, value);}
+    explicit Deque( const BUFFER_ALLOC& alloc ):holder(alloc){ map_init(0);}
 
-    template< class InputIt >
-    Deque( InputIt first, InputIt last){ copy_init(first, last);}
+    Deque( size_type count, const_reference value = T(), const BUFFER_ALLOC& alloc = BUFFER_ALLOC()):holder(alloc){ fill_init(count, value);}
+
+    template< class InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category >
+    Deque( InputIt first, InputIt last, const BUFFER_ALLOC& alloc = BUFFER_ALLOC()):holder(alloc){ copy_init(first, last);}
+
+    Deque(const Deque& other ):holder(alloc_traits::select_on_container_copy_construction(other.alloc())){ copy_init(other.begin_, other.end_);}
+
+    Deque(const Deque& other, const BUFFER_ALLOC& alloc ):holder(alloc){ copy_init(other.begin_, other.end_);}
+
+    // other is left with a fresh empty map, so it stays usable.
+    Deque(Deque&& other ):holder(std::move(other.alloc())){
+        map_init(0);
+        swap_storage(other);
+    }
+
+    Deque& operator=(const Deque& other){
+        if(this == &other) return *this;
+        BUFFER_ALLOC new_alloc = alloc();
+        alloc_traits::on_copy_assign(new_alloc, other.alloc());
+        Deque tmp(other, new_alloc);
+        swap_storage(tmp);
+        std::swap(alloc(), tmp.alloc());
+        return *this;
+    }
 
-    Deque(const Deque& other ){ copy_init(other.begin_, other.end_);}
+    Deque& operator=(Deque&& other){
+        if(this == &other) return *this;
+        if(alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::equal(alloc(), other.alloc())){
+            Deque tmp(std::move(other));
+            swap_storage(tmp);
+            if(alloc_traits::propagate_on_container_move_assignment::value) std::swap(alloc(), tmp.alloc());
+        }else{
+            Deque tmp(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()), alloc());
+            swap_storage(tmp);
+        }
+        return *this;
+    }
 
-    Deque(Deque&& other ):begin_(other.begin_), end_(other.end_), map_(other.map_), map_size_(other.map_size_) {
-        other.map_ = nullptr, other.map_size_ = 0;
+    void swap(Deque& other){
+        swap_storage(other);
+        alloc_traits::on_swap(alloc(), other.alloc());
     }
 
+    allocator_type get_allocator() const{ return alloc();}
+
     ~Deque(){
         if(map_ != nullptr){
-            std::destroy(begin_, end_);
+            segmented_destroy(begin_, end_);
             buffer_deallocate_n(begin_.pnode_, end_.pnode_ + 1);
             map_deallocate();
         }
+        release_spares();
     }
 
-    size_type size(){ return end_ - begin_;}
-    reference operator[]( size_type pos ){ return *(begin_ + pos);}
+    // Hands the cached spare blocks back to the allocator.
+    void shrink_to_fit(){ release_spares();}
+
+    size_type size() const{ return end_ - begin_;}
+    reference operator[]( size_type pos ){
+        size_type offset = pos + (begin_.cur_ - begin_.first_);
+        return begin_.pnode_[offset >> block::SHIFT][offset & block::MASK];
+    }
     reference front(){ return *begin_;}
     reference back(){ return *(end_-1);}
     iterator begin(){ return begin_;}
     iterator end(){ return end_;}
     bool empty() const{ return begin_ == end_;}
 
-    void push_front( const_reference value ){
-        if(begin_.cur_ == begin_.first_){
-            reserve_front(1);
-            *(begin_.pnode_ - 1) = buffer_allocate();
+    template <typename... Args>
+    reference emplace_front( Args&&... args ){
+        if(begin_.cur_ != begin_.first_){
+            ::new(static_cast<void*>(begin_.cur_ - 1)) T(std::forward<Args>(args)...);
+            --begin_.cur_;
+        }else{
+            emplace_front_aux(std::forward<Args>(args)...);
         }
-        new(&(*(--begin_))) value_type(value);
+        return *begin_;
     }
 
-    void push_back( const_reference value ){
-        if(end_.cur_ == end_.last_ - 1){
-            reserve_back(1);
-            *(end_.pnode_ + 1) = buffer_allocate();
+    template <typename... Args>
+    reference emplace_back( Args&&... args ){
+        if(end_.cur_ != end_.last_ - 1){
+            ::new(static_cast<void*>(end_.cur_)) T(std::forward<Args>(args)...);
+            ++end_.cur_;
+        }else{
+            emplace_back_aux(std::forward<Args>(args)...);
         }
-        new(&(*(end_++))) value_type(value);
+        return back();
     }
 
-    iterator insert( iterator pos, const_reference value ){
+    void push_front( const_reference value ){ emplace_front(value);}
+    void push_front( value_type&& value ){ emplace_front(std::move(value));}
+    void push_back( const_reference value ){ emplace_back(value);}
+    void push_back( value_type&& value ){ emplace_back(std::move(value));}
+
+    // Shifts the shorter side by one slot with moves.
+    template <typename... Args>
+    iterator emplace( iterator pos, Args&&... args ){
         if(pos == begin_){
-            push_front(value);
+            emplace_front(std::forward<Args>(args)...);
             return begin_;
         }else if(pos == end_){
-            push_back(value);
+            emplace_back(std::forward<Args>(args)...);
             return end_ - 1;
+        }
+        size_type front_elem_nr = pos - begin_;
+        // The arguments may refer to elements that are about to move.
+        value_type tmp(std::forward<Args>(args)...);
+        if(front_elem_nr < size() / 2){
+            emplace_front(std::move(*begin_));
+            segmented_move(begin_ + 2, begin_ + difference_type(front_elem_nr + 1), begin_ + 1);
         }else{
-            size_type front_elem_nr = pos - begin_;
-            if(front_elem_nr < size() / 2){
-                push_front(*begin_);
-                std::move(begin_ + 2, begin_ + 1 + front_elem_nr, begin_ + 1);
-            }else{
-                push_back(*(end_ - 1));
-                show();
-                std::move_backward(begin_ + front_elem_nr, end_ - 2, end_ - 1);
-            }
-            *(begin_ + front_elem_nr) = value;
-            return begin_ + front_elem_nr;
+            emplace_back(std::move(*(end_ - 1)));
+            segmented_move_backward(begin_ + front_elem_nr, end_ - 2, end_ - 1);
         }
+        iterator it = begin_ + front_elem_nr;
+        *it = std::move(tmp);
+        return it;
+    }
+
+    iterator insert( iterator pos, const_reference value ){
+        return emplace(pos, value);
+    }
+
+    iterator insert( iterator pos, value_type&& value ){
+        return emplace(pos, std::move(value));
     }
 
     iterator insert( iterator pos, size_type count, const_reference value ){
-        size_type front_elem_nr = pos - begin_;
-        reserve_n(pos, count);
-        std::fill_n(begin_ + front_elem_nr, count, value);
-        return begin_ + front_elem_nr;
+        value_type tmp(value);
+        return insert_gap(pos - begin_, count, [&](iterator first, iterator last, size_type, bool raw){
+            if(raw) segmented_uninitialized_fill(first, last, tmp);
+            else segmented_fill(first, last, tmp);
+        });
     }
 
-    template< class InputIt >
+    // The source must not be part of this Deque.
+    template< class InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category >
     iterator insert( iterator pos, InputIt first, InputIt last ){
+        typedef typename std::iterator_traits<InputIt>::iterator_category category;
         size_type front_elem_nr = pos - begin_;
-        size_type count = std::distance(first, last);
-        reserve_n(pos, count);
-        std::copy(first, last, begin_ + front_elem_nr);
-        return begin_ + front_elem_nr;
+        if constexpr(std::is_base_of<std::forward_iterator_tag, category>::value){
+            return insert_gap(front_elem_nr, std::distance(first, last), [&](iterator d_first, iterator d_last, size_type offset, bool raw){
+                InputIt src = std::next(first, offset);
+                InputIt src_last = std::next(src, d_last - d_first);
+                if(raw) segmented_uninitialized_copy(src, src_last, d_first);
+                else segmented_copy(src, src_last, d_first);
+            });
+        }else{
+            size_type old_size = size();
+            for(; first != last; ++first) emplace_back(*first);
+            std::rotate(begin_ + front_elem_nr, begin_ + old_size, end_);
+            return begin_ + front_elem_nr;
+        }
     }
 
     iterator erase( iterator first, iterator last ){
+        difference_type count = last - first;
+        if(count == 0) return first;
         size_type front_elem_nr = first - begin_;
         size_type back_elem_nr = end_ - last;
         if(front_elem_nr < back_elem_nr){
-            iterator ret = std::copy_backward(begin_, first, last);
+            if constexpr(is_trivially_relocatable<T>::value){
+                segmented_destroy(first, last);
+                relocate_backward(begin_, first, last);
+            }else{
+                segmented_move_backward(begin_, first, last);
+                segmented_destroy(begin_, begin_ + count);
+            }
             iterator old_begin = begin_;
-            begin_+= (last - first);
+            begin_ += count;
             buffer_deallocate_n(old_begin.pnode_, begin_.pnode_);
-            return ret;
         }else{
-            iterator ret = std::copy(last, end_, first);
+            if constexpr(is_trivially_relocatable<T>::value){
+                segmented_destroy(first, last);
+                relocate_forward(last, end_, first);
+            }else{
+                segmented_move(last, end_, first);
+                segmented_destroy(end_ - count, end_);
+            }
             iterator old_end = end_;
-            end_-= (last - first);
+            end_ -= count;
             buffer_deallocate_n(end_.pnode_ + 1, old_end.pnode_ + 1);
-            return ret;
         }
+        return begin_ + front_elem_nr;
     }
 
     iterator erase( iterator pos ){
@@ -360,11 +845,21 @@ public:
     }
 
     void pop_back(){
-        erase(end_ - 1);
+        if(end_.cur_ == end_.first_){
+            buffer_deallocate(end_.pnode_);
+            end_.set_node(end_.pnode_ - 1);
+            end_.cur_ = end_.last_;
+        }
+        std::destroy_at(--end_.cur_);
     }
 
     void pop_front(){
-        erase(begin_);
+        std::destroy_at(begin_.cur_);
+        if(++begin_.cur_ == begin_.last_){
+            buffer_deallocate(begin_.pnode_);
+            begin_.set_node(begin_.pnode_ + 1);
+            begin_.cur_ = begin_.first_;
+        }
     }
 
     void resize( size_type count, const value_type& value=value_type() ){
@@ -377,9 +872,7 @@ public:
     }
 
     void show() {
-        for(iterator it = begin(); it != end(); ++it){
-            std::cout << *it << ' ';
-        }
+        segmented_for_each(begin(), end(), [](const T& x){ std::cout << x << ' ';});
         std::cout << std::endl;
         std::cout << "size = " << size() << std::endl;
     }
@@ -1,6 +1,10 @@
 #ifndef __LIST_H
 #define __LIST_H
 
+#include <memory>
+#include <iterator>
+#include <type_traits>
+
 #include "allocator.h"
 
 struct ListNodeBase{
@@ -74,7 +78,7 @@ public:
 };
 
 template<typename T, typename ALLOC=NewAllocator<ListNode<T>>>
-class List{
+class List: private AllocatorHolder<ALLOC>{
     public:
     using iterator = ListIterator<T>;
     using Node = ListNode<T>;
@@ -82,22 +86,134 @@ class List{
     using pointer = T*;
     using reference = T&;
     using size_type = size_t;
+    using allocator_type = ALLOC;
+    using alloc_traits = AllocatorTraits<ALLOC>;
 
     private:
+    using holder = AllocatorHolder<ALLOC>;
+    using holder::alloc;
+
     ListHeader<T> head;
 
-    static Node* create_new_node(const value_type& data){
-        Node* node = ALLOC::allocate(1);
-        node->data_ = data;
+    Node* create_new_node(const value_type& data){
+        Node* node = alloc().allocate(1);
+        try{
+            new(&node->data_) value_type(data);
+        }catch(...){
+            alloc().deallocate(node, 1);
+            throw;
+        }
         return node;
     }
 
-    static void destroy_node(Node* node){
+    void destroy_node(Node* node){
         std::destroy_at(&node->data_);
-        ALLOC::deallocate(node, 1);
+        alloc().deallocate(node, 1);
+    }
+
+    void link_before(ListNodeBase* pos, ListNodeBase* node){
+        node->next_ = pos;
+        node->prev_ = pos->prev_;
+        pos->prev_->next_ = node;
+        pos->prev_ = node;
+        head.size_++;
+    }
+
+    // Constructs count nodes from one allocate_batch() chain in front of pos.
+    // If construct throws, the nodes built so far stay in the list and the
+    // rest of the chain goes back to the allocator.
+    template <typename CONSTRUCT>
+    iterator insert_batch(iterator pos, size_type count, CONSTRUCT construct){
+        Node* nodes = alloc_traits::allocate_batch(alloc(), count);
+        ListNodeBase* before = pos.node_->prev_;
+        for(size_type i = 0; i < count; i++){
+            Node* node = nodes;
+            nodes = batch_next(nodes);
+            try{
+                construct(node);
+            }catch(...){
+                batch_next(node) = nodes;
+                Node* last = node;
+                while(batch_next(last) != nullptr) last = batch_next(last);
+                alloc_traits::deallocate_batch(alloc(), node, last, count - i);
+                throw;
+            }
+            link_before(pos.node_, node);
+        }
+        return iterator(before->next_);
+    }
+
+    // Moves the nodes of other behind head, which must be empty.
+    void steal(List& other){
+        if(other.empty()) return;
+        head.next_ = other.head.next_;
+        head.prev_ = other.head.prev_;
+        head.next_->prev_ = &head;
+        head.prev_->next_ = &head;
+        head.size_ = other.head.size_;
+        other.head.next_ = other.head.prev_ = &other.head;
+        other.head.size_ = 0;
+    }
+
+    void swap_nodes(List& other){
+        List tmp(alloc());
+        tmp.steal(*this);
+        steal(other);
+        other.steal(tmp);
     }
 
     public:
+    List() = default;
+
+    explicit List(const ALLOC& alloc):holder(alloc){}
+
+    List(size_type count, const value_type& value, const ALLOC& alloc = ALLOC()):holder(alloc){
+        insert(end(), count, value);
+    }
+
+    template< class InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category >
+    List(InputIt first, InputIt last, const ALLOC& alloc = ALLOC()):holder(alloc){
+        insert(end(), first, last);
+    }
+
+    List(const List& other):holder(alloc_traits::select_on_container_copy_construction(other.alloc())){
+        insert(end(), other.begin(), other.end());
+    }
+
+    List(List&& other):holder(std::move(other.alloc())){
+        steal(other);
+    }
+
+    List& operator=(const List& other){
+        if(this == &other) return *this;
+        if(alloc_traits::propagate_on_container_copy_assignment::value && !alloc_traits::equal(alloc(), other.alloc())){
+            clear();
+        }
+        alloc_traits::on_copy_assign(alloc(), other.alloc());
+        assign(other.begin(), other.end());
+        return *this;
+    }
+
+    List& operator=(List&& other){
+        if(this == &other) return *this;
+        if(alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::equal(alloc(), other.alloc())){
+            clear();
+            alloc_traits::on_move_assign(alloc(), other.alloc());
+            steal(other);
+        }else{
+            assign(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+        }
+        return *this;
+    }
+
+    void swap(List& other){
+        swap_nodes(other);
+        alloc_traits::on_swap(alloc(), other.alloc());
+    }
+
+    allocator_type get_allocator() const{
+        return alloc();
+    }
 
     iterator begin() const{
         return iterator(head.next_);
@@ -117,30 +233,29 @@ class List{
 
     iterator insert(iterator pos, const value_type& value ){
         Node* node = create_new_node(value);
-        node->next_ = pos.node_;
-        node->prev_ = pos.node_->prev_;
-        pos.node_->prev_->next_ = node;
-        pos.node_->prev_ = node;
-        head.size_++;
+        link_before(pos.node_, node);
         return iterator(node);
     }
 
     iterator insert(iterator pos, size_type count, const value_type& value ){
-        iterator it = pos;
-        for(size_t i = 0; i < count; i++){
-            it = insert(it, value);
-        }
-        return it;
+        if(count == 0) return pos;
+        return insert_batch(pos, count, [&value](Node* node){ new(&node->data_) value_type(value); });
     }
 
-    template< class InputIt >
+    template< class InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category >
     iterator insert( iterator pos, InputIt first, InputIt last ){
         if(first == last) return pos;
-        iterator it = insert(pos, *(first++));
-        for(; first != last; ++first){
-            insert(pos, *first);
+        typedef typename std::iterator_traits<InputIt>::iterator_category category;
+        if constexpr(std::is_base_of<std::forward_iterator_tag, category>::value){
+            size_type count = std::distance(first, last);
+            return insert_batch(pos, count, [&first](Node* node){ new(&node->data_) value_type(*first); ++first; });
+        }else{
+            iterator it = insert(pos, *(first++));
+            for(; first != last; ++first){
+                insert(pos, *first);
+            }
+            return it;
         }
-        return it;
     }
 
     reference front(){
@@ -175,7 +290,6 @@ class List{
         iterator it = begin();
         size_type i = 0;
         for(; i < count && it != end(); ++i, ++it){
-            std::destroy_at(&(*it));
             *it = value;
         }
         if(i < count) insert(it, count - i, value);
@@ -186,7 +300,6 @@ class List{
     void assign( InputIt first, InputIt last ){
         iterator it = begin();
         for(; first != last && it != end(); ++first, ++it){
-            std::destroy_at(&(*it));
             *it = *first;
         }
         if(first != last) insert(it, first, last);
@@ -212,12 +325,16 @@ class List{
     }
 
     void clear(){
-        iterator it = begin();
-        while(it != end()){
-            Node* node = static_cast<Node*>(it.node_);
-            ++it;
-            destroy_node(node);
+        if(empty()) return;
+        Node* first = static_cast<Node*>(head.next_);
+        Node* last = static_cast<Node*>(head.prev_);
+        for(ListNodeBase* p = head.next_; p != &head;){
+            Node* node = static_cast<Node*>(p);
+            p = p->next_;
+            std::destroy_at(&node->data_);
+            batch_next(node) = static_cast<Node*>(p);
         }
+        alloc_traits::deallocate_batch(alloc(), first, last, head.size_);
         head.size_ = 0;
         head.next_ = head.prev_ = &head;
     }
@@ -17,7 +17,14 @@ class Map{
         RBTree<const key_type, value_type, std::_Select1st<value_type>, Compare, Allocator> rbtree_;
     public:
         Map() = default;
+        explicit Map(const Compare& comp, const Allocator& alloc = Allocator()):rbtree_(comp, alloc){}
+        explicit Map(const Allocator& alloc):rbtree_(Compare(), alloc){}
         Map(const Map& other) = default;
+        Map(Map&& other) = default;
+        Map& operator=(const Map& other) = default;
+        Map& operator=(Map&& other) = default;
+
+        Allocator get_allocator() const{ return rbtree_.get_allocator();}
         T& operator[]( const Key& key ){
             iterator it = rbtree_.find(key);
             if(it == rbtree_.end()){
@@ -91,7 +98,14 @@ class MultiMap{
         RBTree<const key_type, value_type, std::_Select1st<value_type>, Compare, Allocator> rbtree_;
     public:
         MultiMap() = default;
+        explicit MultiMap(const Compare& comp, const Allocator& alloc = Allocator()):rbtree_(comp, alloc){}
+        explicit MultiMap(const Allocator& alloc):rbtree_(Compare(), alloc){}
         MultiMap(const MultiMap& other) = default;
+        MultiMap(MultiMap&& other) = default;
+        MultiMap& operator=(const MultiMap& other) = default;
+        MultiMap& operator=(MultiMap&& other) = default;
+
+        Allocator get_allocator() const{ return rbtree_.get_allocator();}
 
         iterator begin(){ return rbtree_.begin();}
 
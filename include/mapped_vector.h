@@ -0,0 +1,292 @@
+#ifndef __MAPPED_VECTOR_H
+#define __MAPPED_VECTOR_H
+
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A Vector whose storage is a shared mapping of a file. The file starts with
+// a small header that records the element size and count, followed by the
+// elements themselves, so reopening a file is just a mmap. Growing extends
+// the file with ftruncate and remaps it; sync() flushes the header and data.
+// Until open() is called the vector lives in an anonymous mapping that grows
+// the same way; open() discards it.
+template<typename T>
+class MappedVector{
+    static_assert(std::is_trivially_copyable<T>::value, "MappedVector stores raw bytes");
+    static_assert(alignof(T) <= 64, "elements must fit the header alignment");
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef T& reference;
+        typedef const T* const_pointer;
+        typedef const value_type& const_reference;
+        typedef size_t size_type;
+        typedef pointer iterator;
+        typedef const_pointer const_iterator;
+        enum{ HEADER_SIZE = 64 };
+        static const uint64_t MAGIC = 0x4d41505045445643ull;
+    private:
+        struct header{
+            uint64_t magic;
+            uint64_t elem_size;
+            uint64_t size;
+        };
+
+        int fd_;
+        char* base_;
+        size_t mapped_bytes_;
+        pointer start_;
+        pointer finish_;
+        pointer end_of_storage_;
+
+        static void fail(const char* what){
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+
+        header* head(){ return reinterpret_cast<header*>(base_);}
+
+        // Maps the file, or anonymous memory when none is open.
+        void map(size_t bytes_nr){
+            int flags = fd_ >= 0 ? MAP_SHARED : MAP_PRIVATE | MAP_ANONYMOUS;
+            void* p = ::mmap(nullptr, bytes_nr, PROT_READ | PROT_WRITE, flags, fd_, 0);
+            if(p == MAP_FAILED) fail("MappedVector mmap");
+            base_ = static_cast<char*>(p);
+            mapped_bytes_ = bytes_nr;
+        }
+
+        // Points the element range at the current mapping.
+        void attach(size_type size, size_type cap){
+            start_ = reinterpret_cast<pointer>(base_ + HEADER_SIZE);
+            finish_ = start_ + size;
+            end_of_storage_ = start_ + cap;
+        }
+
+        void remap(size_type new_cap){
+            size_type old_size = size();
+            size_t bytes_nr = HEADER_SIZE + new_cap * sizeof(T);
+            if(fd_ >= 0 && ::ftruncate(fd_, bytes_nr) != 0) fail("MappedVector ftruncate");
+            if(base_ == nullptr){
+                map(bytes_nr);
+            }else{
+#ifdef MREMAP_MAYMOVE
+                void* p = ::mremap(base_, mapped_bytes_, bytes_nr, MREMAP_MAYMOVE);
+                if(p == MAP_FAILED) fail("MappedVector mremap");
+                base_ = static_cast<char*>(p);
+                mapped_bytes_ = bytes_nr;
+#else
+                char* old_base = base_;
+                size_t old_bytes_nr = mapped_bytes_;
+                map(bytes_nr);
+                if(fd_ < 0) std::memcpy(base_, old_base, std::min(old_bytes_nr, bytes_nr));
+                ::munmap(old_base, old_bytes_nr);
+#endif
+            }
+            attach(old_size, new_cap);
+        }
+
+        size_type grow_capacity(size_type count) const{
+            size_type min_cap = std::max<size_type>(4096 / sizeof(T), 1);
+            return std::max({2 * capacity(), size() + count, min_cap});
+        }
+
+        __attribute__((noinline, cold)) void grow(size_type count){
+            remap(grow_capacity(count));
+        }
+
+    public:
+        MappedVector():fd_(-1), base_(nullptr), mapped_bytes_(0), start_(nullptr), finish_(nullptr), end_of_storage_(nullptr){}
+
+        explicit MappedVector(const char* path):MappedVector(){
+            try{
+                open(path);
+            }catch(...){
+                close();
+                throw;
+            }
+        }
+
+        MappedVector(const MappedVector&) = delete;
+        MappedVector& operator=(const MappedVector&) = delete;
+
+        MappedVector(MappedVector&& other):MappedVector(){
+            swap(other);
+        }
+
+        MappedVector& operator=(MappedVector&& other){
+            if(this != &other){
+                close();
+                swap(other);
+            }
+            return *this;
+        }
+
+        ~MappedVector(){
+            close();
+        }
+
+        // Opens path, creating an empty vector if the file does not exist.
+        // Throws std::system_error on I/O errors and std::runtime_error when
+        // the file was not written by a MappedVector of the same element size.
+        void open(const char* path){
+            close();
+            fd_ = ::open(path, O_RDWR | O_CREAT, 0644);
+            if(fd_ < 0) fail("MappedVector open");
+            struct stat st;
+            if(::fstat(fd_, &st) != 0) fail("MappedVector fstat");
+            size_t bytes_nr = st.st_size;
+            if(bytes_nr == 0){
+                bytes_nr = HEADER_SIZE;
+                if(::ftruncate(fd_, bytes_nr) != 0) fail("MappedVector ftruncate");
+                map(bytes_nr);
+                head()->magic = MAGIC;
+                head()->elem_size = sizeof(T);
+                head()->size = 0;
+            }else{
+                map(bytes_nr);
+                size_type cap = (bytes_nr >= HEADER_SIZE)? (bytes_nr - HEADER_SIZE) / sizeof(T) : 0;
+                if(bytes_nr < HEADER_SIZE || head()->magic != MAGIC || head()->elem_size != sizeof(T) || head()->size > cap){
+                    close();
+                    throw std::runtime_error("MappedVector: incompatible file");
+                }
+            }
+            attach(head()->size, (mapped_bytes_ - HEADER_SIZE) / sizeof(T));
+        }
+
+        void close(){
+            if(base_ != nullptr){
+                head()->size = size();
+                ::munmap(base_, mapped_bytes_);
+            }
+            if(fd_ >= 0) ::close(fd_);
+            fd_ = -1;
+            base_ = nullptr;
+            mapped_bytes_ = 0;
+            start_ = finish_ = end_of_storage_ = nullptr;
+        }
+
+        bool is_open() const { return fd_ >= 0;}
+
+        // Records the size in the header and writes everything to the file.
+        void sync(){
+            if(fd_ < 0) return;
+            head()->size = size();
+            if(::msync(base_, mapped_bytes_, MS_SYNC) != 0) fail("MappedVector msync");
+        }
+
+        void swap( MappedVector& other ){
+            std::swap(fd_, other.fd_);
+            std::swap(base_, other.base_);
+            std::swap(mapped_bytes_, other.mapped_bytes_);
+            std::swap(start_, other.start_);
+            std::swap(finish_, other.finish_);
+            std::swap(end_of_storage_, other.end_of_storage_);
+        }
+
+        iterator begin() { return start_; }
+        iterator end() { return finish_; }
+        const_iterator begin() const { return start_; }
+        const_iterator end() const { return finish_; }
+        size_type size() const { return finish_ - start_; }
+        size_type capacity() const { return end_of_storage_ - start_; }
+        bool empty() const { return begin() == end(); }
+        reference front() { return (*this)[0];}
+        reference back() { return (*this)[size() - 1]; }
+        pointer data() { return start_;}
+        reference operator[]( size_type pos ){ return *(begin() + pos);}
+        const_reference operator[]( size_type pos ) const{ return *(begin() + pos);}
+
+        void clear(){
+            finish_ = start_;
+        }
+
+        void reserve( size_type new_cap ){
+            if(new_cap > capacity()) remap(new_cap);
+        }
+
+        void push_back( const T& value ){
+            emplace_back(value);
+        }
+
+        // Growing may move the mapping, so the element is built first: args
+        // may refer to an element of this vector.
+        template <typename... Args>
+        reference emplace_back( Args&&... args ){
+            if(finish_ == end_of_storage_){
+                T tmp(std::forward<Args>(args)...);
+                grow(1);
+                ::new(static_cast<void*>(finish_)) T(tmp);
+            }else{
+                ::new(static_cast<void*>(finish_)) T(std::forward<Args>(args)...);
+            }
+            return *finish_++;
+        }
+
+        // The range may be part of this vector.
+        template <typename ForwardIt>
+        void append( ForwardIt first, ForwardIt last ){
+            typedef typename std::iterator_traits<ForwardIt>::iterator_category category;
+            static_assert(std::is_base_of<std::forward_iterator_tag, category>::value, "append needs a forward range");
+            size_type count = std::distance(first, last);
+            if(size() + count > capacity()){
+                if constexpr(std::is_convertible<ForwardIt, const_pointer>::value){
+                    const_pointer p = first;
+                    if(std::less_equal<const_pointer>()(start_, p) && std::less<const_pointer>()(p, finish_)){
+                        size_type offset = p - start_;
+                        grow(count);
+                        finish_ = std::copy_n(start_ + offset, count, finish_);
+                        return;
+                    }
+                }
+                grow(count);
+            }
+            finish_ = std::copy(first, last, finish_);
+        }
+
+        iterator erase( iterator first, iterator last ){
+            finish_ = std::copy(last, end(), first);
+            return first;
+        }
+
+        iterator erase( iterator pos ){
+            return erase(pos, pos + 1);
+        }
+
+        void pop_back(){
+            --finish_;
+        }
+
+        void resize( size_type count, const value_type& value = value_type() ){
+            if(count > capacity()) remap(count);
+            if(count > size()) std::fill(finish_, start_ + count, value);
+            finish_ = start_ + count;
+        }
+
+        // Gives the unused capacity back to the file system.
+        void shrink_to_fit(){
+            if(base_ != nullptr && capacity() > size()) remap(size());
+        }
+
+        void show() const{
+            for(auto &x : *this){
+                std::cout << x << " ";
+            }
+            std::cout << std::endl;
+            std::cout<<"size: "<<size()<<' '
+                     <<"capacity: "<<capacity()<<std::endl;
+        }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,218 @@
+#ifndef __MPMC_QUEUE_H
+#define __MPMC_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#include "allocator.h"
+
+// Failed attempts a blocking push or pop makes busy-waiting, and then
+// yielding the CPU, before it parks the thread.
+#ifndef MPMC_SPIN_COUNT
+#define MPMC_SPIN_COUNT 256
+#endif
+
+#ifndef MPMC_YIELD_COUNT
+#define MPMC_YIELD_COUNT 16
+#endif
+
+inline void cpu_relax(){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// A bounded queue for any number of producer and consumer threads, after
+// Dmitry Vyukov's design. Every slot carries a sequence number saying whose
+// turn it is: a producer may fill slot i when its sequence equals the ticket
+// it took from tail_, a consumer may empty it when the sequence is one past
+// its ticket from head_. Claiming a ticket is one CAS; the slot hand-over is
+// an acquire load and a release store on that slot alone.
+//
+// push, emplace and pop block: they spin, then yield, and then sleep until
+// the other side makes room (or an element). The try_ versions
+// never block. There is no front(), since another consumer could take the
+// element between looking at it and popping it.
+template<typename T, size_t CAPACITY>
+class MpmcQueue{
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two of at least 2");
+    static_assert(std::is_nothrow_move_constructible<T>::value, "elements are moved in and out of slots");
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef T& reference;
+        typedef const value_type& const_reference;
+        typedef size_t size_type;
+        enum{ MASK = CAPACITY - 1 };
+    private:
+        struct cell{
+            std::atomic<size_type> seq;
+            alignas(T) unsigned char storage[sizeof(T)];
+
+            pointer value(){ return reinterpret_cast<pointer>(storage);}
+        };
+
+        alignas(CACHE_LINE_SIZE) std::atomic<size_type> tail_;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_type> head_;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_type> push_waiters_;
+        std::atomic<size_type> pop_waiters_;
+        std::mutex park_lock_;
+        std::condition_variable not_full_;
+        std::condition_variable not_empty_;
+        alignas(CACHE_LINE_SIZE) cell cells_[CAPACITY];
+
+        // Takes a producer ticket, or returns nullptr if the queue is full.
+        cell* claim_push(size_type& pos){
+            pos = tail_.load(std::memory_order_relaxed);
+            while(true){
+                cell* c = &cells_[pos & MASK];
+                intptr_t diff = intptr_t(c->seq.load(std::memory_order_acquire)) - intptr_t(pos);
+                if(diff == 0){
+                    if(tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) return c;
+                }else if(diff < 0){
+                    return nullptr;
+                }else{
+                    pos = tail_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Takes a consumer ticket, or returns nullptr if the queue is empty.
+        cell* claim_pop(size_type& pos){
+            pos = head_.load(std::memory_order_relaxed);
+            while(true){
+                cell* c = &cells_[pos & MASK];
+                intptr_t diff = intptr_t(c->seq.load(std::memory_order_acquire)) - intptr_t(pos + 1);
+                if(diff == 0){
+                    if(head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) return c;
+                }else if(diff < 0){
+                    return nullptr;
+                }else{
+                    pos = head_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Wakes one thread parked on cv. The fence pairs with the one in
+        // park: either the sleeper sees our slot update, or we see it waiting.
+        void wake(std::atomic<size_type>& waiters, std::condition_variable& cv){
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(waiters.load(std::memory_order_relaxed) > 0){
+                std::lock_guard<std::mutex> guard(park_lock_);
+                cv.notify_one();
+            }
+        }
+
+        // Retries attempt() until it succeeds, spinning first, then yielding
+        // and finally sleeping on cv between tries.
+        template <typename ATTEMPT>
+        void park(std::atomic<size_type>& waiters, std::condition_variable& cv, ATTEMPT attempt){
+            for(int i = 0; i < MPMC_SPIN_COUNT; i++){
+                if(attempt()) return;
+                cpu_relax();
+            }
+            for(int i = 0; i < MPMC_YIELD_COUNT; i++){
+                if(attempt()) return;
+                std::this_thread::yield();
+            }
+            std::unique_lock<std::mutex> guard(park_lock_);
+            waiters.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            cv.wait(guard, attempt);
+            waiters.fetch_sub(1);
+        }
+
+        template <typename... Args>
+        bool fill_slot( Args&&... args ){
+            if constexpr(std::is_nothrow_constructible<T, Args&&...>::value){
+                size_type pos;
+                cell* c = claim_push(pos);
+                if(c == nullptr) return false;
+                ::new(static_cast<void*>(c->value())) T(std::forward<Args>(args)...);
+                c->seq.store(pos + 1, std::memory_order_release);
+            }else{
+                // Build it before taking a slot, so a throwing constructor
+                // cannot leave a claimed slot that never fills.
+                T tmp(std::forward<Args>(args)...);
+                size_type pos;
+                cell* c = claim_push(pos);
+                if(c == nullptr) return false;
+                ::new(static_cast<void*>(c->value())) T(std::move(tmp));
+                c->seq.store(pos + 1, std::memory_order_release);
+            }
+            return true;
+        }
+
+        bool empty_slot( reference value ){
+            size_type pos;
+            cell* c = claim_pop(pos);
+            if(c == nullptr) return false;
+            value = std::move(*c->value());
+            std::destroy_at(c->value());
+            c->seq.store(pos + MASK + 1, std::memory_order_release);
+            return true;
+        }
+
+    public:
+        MpmcQueue():tail_(0), head_(0), push_waiters_(0), pop_waiters_(0){
+            for(size_type i = 0; i < CAPACITY; i++) cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        MpmcQueue(const MpmcQueue&) = delete;
+        MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+        ~MpmcQueue(){
+            size_type head = head_.load(std::memory_order_relaxed), tail = tail_.load(std::memory_order_relaxed);
+            for(; head != tail; ++head) std::destroy_at(cells_[head & MASK].value());
+        }
+
+        static constexpr size_type capacity(){ return CAPACITY;}
+
+        // A snapshot that may be stale by the time it returns.
+        size_type size() const{
+            size_type head = head_.load(std::memory_order_acquire);
+            size_type tail = tail_.load(std::memory_order_acquire);
+            return tail > head ? tail - head : 0;
+        }
+        bool empty() const{ return size() == 0;}
+
+        template <typename... Args>
+        bool try_emplace( Args&&... args ){
+            if(!fill_slot(std::forward<Args>(args)...)) return false;
+            wake(pop_waiters_, not_empty_);
+            return true;
+        }
+
+        bool try_push( const_reference value ){ return try_emplace(value);}
+        bool try_push( value_type&& value ){ return try_emplace(std::move(value));}
+
+        bool try_pop( reference value ){
+            if(!empty_slot(value)) return false;
+            wake(push_waiters_, not_full_);
+            return true;
+        }
+
+        template <typename... Args>
+        void emplace( Args&&... args ){
+            T tmp(std::forward<Args>(args)...);
+            park(push_waiters_, not_full_, [&]{ return fill_slot(std::move(tmp));});
+            wake(pop_waiters_, not_empty_);
+        }
+
+        void push( const_reference value ){ emplace(value);}
+        void push( value_type&& value ){ emplace(std::move(value));}
+
+        void pop( reference value ){
+            park(pop_waiters_, not_empty_, [&]{ return empty_slot(value);});
+            wake(push_waiters_, not_full_);
+        }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,142 @@
+#ifndef __PARALLEL_H
+#define __PARALLEL_H
+
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <vector>
+
+#include "task_scheduler.h"
+
+// Ranges shorter than this run the serial algorithm.
+#ifndef PARALLEL_SERIAL_THRESHOLD
+#define PARALLEL_SERIAL_THRESHOLD 32768
+#endif
+
+// Smallest chunk handed to one thread, in bytes of elements.
+#ifndef PARALLEL_CHUNK_BYTES
+#define PARALLEL_CHUNK_BYTES (64 * 1024)
+#endif
+
+// Elements per chunk: at least PARALLEL_CHUNK_BYTES worth, and small enough
+// to give every thread about four chunks.
+template <typename T>
+inline size_t parallel_chunk_size(size_t n){
+    size_t min_chunk = std::max<size_t>(PARALLEL_CHUNK_BYTES / sizeof(T), 1);
+    return std::max(min_chunk, n / (TaskScheduler::instance().thread_count() * 4) + 1);
+}
+
+inline bool parallel_worthwhile(size_t n){
+    return n >= PARALLEL_SERIAL_THRESHOLD && TaskScheduler::instance().thread_count() > 1;
+}
+
+// Calls fn(chunk_index, begin, end) for consecutive chunks of [0, n).
+template <typename T, typename FN>
+inline size_t parallel_chunks(size_t n, FN&& fn){
+    size_t chunk = parallel_chunk_size<T>(n);
+    size_t chunk_nr = (n + chunk - 1) / chunk;
+    TaskScheduler::instance().parallel_for(chunk_nr, [&](size_t c){
+        fn(c, c * chunk, std::min(n, (c + 1) * chunk));
+    });
+    return chunk_nr;
+}
+
+// The algorithms below take random-access ranges such as Vector's pointers
+// or Deque's DequeIterator.
+
+template <typename RandomIt, typename UnaryFunction>
+void parallel_for_each(RandomIt first, RandomIt last, UnaryFunction f){
+    typedef typename std::iterator_traits<RandomIt>::value_type T;
+    size_t n = last - first;
+    if(!parallel_worthwhile(n)){
+        std::for_each(first, last, f);
+        return;
+    }
+    parallel_chunks<T>(n, [&](size_t, size_t b, size_t e){ std::for_each(first + b, first + e, f);});
+}
+
+template <typename RandomIt, typename OutputIt, typename UnaryOperation>
+OutputIt parallel_transform(RandomIt first, RandomIt last, OutputIt d_first, UnaryOperation op){
+    typedef typename std::iterator_traits<RandomIt>::value_type T;
+    size_t n = last - first;
+    if(!parallel_worthwhile(n)) return std::transform(first, last, d_first, op);
+    parallel_chunks<T>(n, [&](size_t, size_t b, size_t e){ std::transform(first + b, first + e, d_first + b, op);});
+    return d_first + n;
+}
+
+// op must be associative; chunks are folded left to right after init.
+template <typename RandomIt, typename T, typename BinaryOp>
+T parallel_reduce(RandomIt first, RandomIt last, T init, BinaryOp op){
+    typedef typename std::iterator_traits<RandomIt>::value_type V;
+    size_t n = last - first;
+    if(!parallel_worthwhile(n)) return std::accumulate(first, last, init, op);
+    size_t chunk_nr = (n + parallel_chunk_size<V>(n) - 1) / parallel_chunk_size<V>(n);
+    std::vector<T> partial(chunk_nr);
+    parallel_chunks<V>(n, [&](size_t c, size_t b, size_t e){
+        partial[c] = std::accumulate(first + b + 1, first + e, T(*(first + b)), op);
+    });
+    for(auto& x : partial) init = op(init, x);
+    return init;
+}
+
+template <typename RandomIt, typename T>
+T parallel_reduce(RandomIt first, RandomIt last, T init){
+    return parallel_reduce(first, last, init, std::plus<>());
+}
+
+// Two passes: per-chunk totals, then each chunk scans from its offset.
+template <typename RandomIt, typename OutputIt, typename BinaryOp>
+OutputIt parallel_inclusive_scan(RandomIt first, RandomIt last, OutputIt d_first, BinaryOp op){
+    typedef typename std::iterator_traits<RandomIt>::value_type T;
+    size_t n = last - first;
+    if(!parallel_worthwhile(n)) return std::inclusive_scan(first, last, d_first, op);
+    size_t chunk_nr = (n + parallel_chunk_size<T>(n) - 1) / parallel_chunk_size<T>(n);
+    std::vector<T> offset(chunk_nr);
+    parallel_chunks<T>(n, [&](size_t c, size_t b, size_t e){
+        offset[c] = std::accumulate(first + b + 1, first + e, T(*(first + b)), op);
+    });
+    for(size_t c = 1; c < chunk_nr; c++) offset[c] = op(offset[c - 1], offset[c]);
+    parallel_chunks<T>(n, [&](size_t c, size_t b, size_t e){
+        if(c == 0) std::inclusive_scan(first + b, first + e, d_first + b, op);
+        else std::inclusive_scan(first + b, first + e, d_first + b, op, offset[c - 1]);
+    });
+    return d_first + n;
+}
+
+template <typename RandomIt, typename OutputIt>
+OutputIt parallel_inclusive_scan(RandomIt first, RandomIt last, OutputIt d_first){
+    return parallel_inclusive_scan(first, last, d_first, std::plus<>());
+}
+
+// Sorts one run per thread, then merges neighbouring runs in parallel rounds.
+template <typename RandomIt, typename Compare>
+void parallel_sort(RandomIt first, RandomIt last, Compare comp){
+    size_t n = last - first;
+    if(!parallel_worthwhile(n)){
+        std::sort(first, last, comp);
+        return;
+    }
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    size_t run_nr = scheduler.thread_count();
+    size_t run = (n + run_nr - 1) / run_nr;
+    scheduler.parallel_for(run_nr, [&](size_t r){
+        std::sort(first + std::min(n, r * run), first + std::min(n, (r + 1) * run), comp);
+    });
+    for(size_t width = run; width < n; width *= 2){
+        size_t pair_nr = (n + 2 * width - 1) / (2 * width);
+        scheduler.parallel_for(pair_nr, [&](size_t p){
+            size_t b = p * 2 * width;
+            size_t m = std::min(n, b + width), e = std::min(n, b + 2 * width);
+            if(m < e) std::inplace_merge(first + b, first + m, first + e, comp);
+        });
+    }
+}
+
+template <typename RandomIt>
+void parallel_sort(RandomIt first, RandomIt last){
+    parallel_sort(first, last, std::less<>());
+}
+
+#endif
\ No newline at end of file
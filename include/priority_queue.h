@@ -0,0 +1,259 @@
+#ifndef __PRIORITY_QUEUE_H
+#define __PRIORITY_QUEUE_H
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <utility>
+
+#include "vector.h"
+
+// Children per heap node. A wider heap is shallower, so a push compares
+// against fewer ancestors, and the children a pop scans sit next to each
+// other in memory: eight ints or four doubles are one cache line.
+#ifndef PRIORITY_QUEUE_ARITY
+#define PRIORITY_QUEUE_ARITY 4
+#endif
+
+// Implicit ARITY-ary heap helpers over [first, first + n). Both move a value
+// through a hole rather than swapping, and store with place(index, value) so
+// an indexed heap can note where each element lands.
+
+// Moves the hole at index hole towards the root while its parent ranks
+// below value, then places value in it.
+template <size_t ARITY, typename RandomIt, typename Compare, typename PLACE>
+void heap_sift_up( RandomIt first, size_t hole, typename std::iterator_traits<RandomIt>::value_type&& value, Compare& comp, PLACE place ){
+    while(hole > 0){
+        size_t parent = (hole - 1) / ARITY;
+        if(!comp(first[parent], value)) break;
+        place(hole, std::move(first[parent]));
+        hole = parent;
+    }
+    place(hole, std::move(value));
+}
+
+// Moves the hole at index hole towards the leaves while its highest-ranked
+// child ranks above value, then places value in it.
+template <size_t ARITY, typename RandomIt, typename Compare, typename PLACE>
+void heap_sift_down( RandomIt first, size_t n, size_t hole, typename std::iterator_traits<RandomIt>::value_type&& value, Compare& comp, PLACE place ){
+    while(true){
+        size_t child = hole * ARITY + 1;
+        if(child >= n) break;
+        size_t last = std::min(child + ARITY, n);
+        size_t best = child;
+        for(size_t i = child + 1; i < last; i++){
+            if(comp(first[best], first[i])) best = i;
+        }
+        if(!comp(value, first[best])) break;
+        place(hole, std::move(first[best]));
+        hole = best;
+    }
+    place(hole, std::move(value));
+}
+
+// Orders [first, first + n) into a heap bottom-up, in O(n).
+template <size_t ARITY, typename RandomIt, typename Compare, typename PLACE>
+void heap_make( RandomIt first, size_t n, Compare& comp, PLACE place ){
+    if(n < 2) return;
+    for(size_t i = (n - 2) / ARITY + 1; i-- > 0;){
+        typename std::iterator_traits<RandomIt>::value_type value(std::move(first[i]));
+        heap_sift_down<ARITY>(first, n, i, std::move(value), comp, place);
+    }
+}
+
+// A max-heap adapter like std::priority_queue: top() is the element that
+// no other ranks above under Compare, so std::greater gives a min-heap.
+// SEQUENCE must have random access iterators.
+template<typename T, typename Compare = std::less<T>, typename SEQUENCE = Vector<T>, size_t ARITY = PRIORITY_QUEUE_ARITY>
+class PriorityQueue{
+    static_assert(ARITY >= 2, "ARITY must be at least 2");
+    public:
+    typedef T value_type;
+    typedef T& reference;
+    typedef T* pointer;
+    typedef const value_type& const_reference;
+    typedef size_t size_type;
+    private:
+    SEQUENCE c;
+    Compare comp;
+
+    void sift_up( size_type hole, value_type&& value ){
+        auto first = c.begin();
+        heap_sift_up<ARITY>(first, hole, std::move(value), comp, [first](size_type i, value_type&& v){ first[i] = std::move(v);});
+    }
+
+    void sift_down( size_type hole, value_type&& value ){
+        auto first = c.begin();
+        heap_sift_down<ARITY>(first, c.size(), hole, std::move(value), comp, [first](size_type i, value_type&& v){ first[i] = std::move(v);});
+    }
+
+    public:
+    PriorityQueue() = default;
+    explicit PriorityQueue( const Compare& compare ):comp(compare){}
+
+    template< class InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category >
+    PriorityQueue( InputIt first, InputIt last, const Compare& compare = Compare() ):comp(compare){
+        push_range(first, last);
+    }
+
+    const_reference top(){ return c.front();}
+
+    bool empty() const{ return c.empty();}
+
+    size_type size() const{ return c.size();}
+
+    void pop(){
+        value_type value(std::move(c.back()));
+        c.pop_back();
+        if(!c.empty()) sift_down(0, std::move(value));
+    }
+
+    void push( const value_type& value ){ emplace(value);}
+
+    void push( value_type&& value ){ emplace(std::move(value));}
+
+    template <typename... Args>
+    void emplace( Args&&... args ){
+        c.emplace_back(std::forward<Args>(args)...);
+        value_type value(std::move(c.back()));
+        sift_up(c.size() - 1, std::move(value));
+    }
+
+    // Appends the range and restores the heap. A batch that is small next
+    // to the heap is sifted up element by element; otherwise the whole heap
+    // is rebuilt bottom-up, which is O(n) instead of O(k log n).
+    template< class InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category >
+    void push_range( InputIt first, InputIt last ){
+        size_type old_size = c.size();
+        for(; first != last; ++first) c.emplace_back(*first);
+        size_type count = c.size() - old_size, depth = 0;
+        for(size_type n = c.size(); n > 0; n /= ARITY) depth++;
+        if(count * depth < c.size()){
+            for(size_type i = old_size; i < c.size(); i++){
+                value_type value(std::move(c.begin()[i]));
+                sift_up(i, std::move(value));
+            }
+        }else{
+            auto begin = c.begin();
+            heap_make<ARITY>(begin, c.size(), comp, [begin](size_type i, value_type&& v){ begin[i] = std::move(v);});
+        }
+    }
+
+    void show() { c.show();}
+};
+
+// A heap of items named by small integer ids, such as timers or graph
+// vertices, that can find any item and change its priority in place. It
+// keeps each id's heap slot in a table indexed by id, so ids should be
+// dense: the table grows to the largest id pushed.
+template<typename T, typename Compare = std::less<T>, size_t ARITY = PRIORITY_QUEUE_ARITY>
+class IndexedPriorityQueue{
+    static_assert(ARITY >= 2, "ARITY must be at least 2");
+    public:
+        typedef T value_type;
+        typedef const value_type& const_reference;
+        typedef size_t size_type;
+        static constexpr size_type npos = size_type(-1);
+    private:
+        struct entry{
+            value_type value;
+            size_type id;
+        };
+
+        struct entry_compare{
+            Compare comp;
+            bool operator()( const entry& a, const entry& b ) const{ return comp(a.value, b.value);}
+        };
+
+        Vector<entry> heap_;
+        // Heap slot of each id, or npos when the id is not queued.
+        Vector<size_type> slot_;
+        entry_compare comp_;
+
+        auto placer(){
+            entry* first = heap_.data();
+            size_type* slot = slot_.data();
+            return [first, slot](size_type i, entry&& e){
+                slot[e.id] = i;
+                first[i] = std::move(e);
+            };
+        }
+
+        void sift_up( size_type hole, entry&& e ){
+            heap_sift_up<ARITY>(heap_.data(), hole, std::move(e), comp_, placer());
+        }
+
+        void sift_down( size_type hole, entry&& e ){
+            heap_sift_down<ARITY>(heap_.data(), heap_.size(), hole, std::move(e), comp_, placer());
+        }
+
+        // Takes the entry at hole out of the heap and refills the hole with
+        // the last entry.
+        void remove_at( size_type hole ){
+            slot_[heap_[hole].id] = npos;
+            entry last(std::move(heap_.back()));
+            heap_.pop_back();
+            if(hole == heap_.size()) return;
+            if(hole > 0 && comp_(heap_[(hole - 1) / ARITY], last)) sift_up(hole, std::move(last));
+            else sift_down(hole, std::move(last));
+        }
+
+    public:
+        IndexedPriorityQueue() = default;
+        explicit IndexedPriorityQueue( const Compare& compare ):comp_{compare}{}
+
+        bool empty() const{ return heap_.empty();}
+        size_type size() const{ return heap_.size();}
+
+        bool contains( size_type id ) const{ return id < slot_.size() && slot_[id] != npos;}
+
+        const_reference top() const{ return heap_[0].value;}
+        size_type top_id() const{ return heap_[0].id;}
+
+        // The priority of a queued id.
+        const_reference priority( size_type id ) const{ return heap_[slot_[id]].value;}
+
+        // Queues id, which must not be queued already.
+        void push( size_type id, const value_type& value ){
+            if(id >= slot_.size()) slot_.resize(std::max(id + 1, 2 * slot_.size()), npos);
+            heap_.push_back(entry{value, id});
+            entry e(std::move(heap_.back()));
+            sift_up(heap_.size() - 1, std::move(e));
+        }
+
+        void pop(){ remove_at(0);}
+
+        // Raises a queued id to value, which must not rank below its current
+        // priority; only the path to the root is touched. With std::greater,
+        // as for timers or Dijkstra, that is a smaller key.
+        void decrease_key( size_type id, const value_type& value ){
+            size_type hole = slot_[id];
+            sift_up(hole, entry{value, id});
+        }
+
+        // Sets a queued id's priority to value, moving it whichever way that
+        // requires.
+        void update( size_type id, const value_type& value ){
+            size_type hole = slot_[id];
+            entry e{value, id};
+            if(comp_(heap_[hole], e)) sift_up(hole, std::move(e));
+            else sift_down(hole, std::move(e));
+        }
+
+        void erase( size_type id ){ remove_at(slot_[id]);}
+
+        void clear(){
+            for(const entry& e : heap_) slot_[e.id] = npos;
+            heap_.clear();
+        }
+
+        void show(){
+            for(const entry& e : heap_){
+                std::cout << e.id << ": " << e.value << ' ';
+            }
+            std::cout << std::endl;
+            std::cout << "size = " << heap_.size() << std::endl;
+        }
+};
+
+#endif
\ No newline at end of file
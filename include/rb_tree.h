@@ -126,7 +126,7 @@ struct RBTreeIterator{
 };
 
 template <typename KEY, typename VALUE, typename KEY_OF_VALUE, typename COMPARE = std::less<KEY>, typename ALLOC = NewAllocator<RBTreeNode<VALUE>>>
-class RBTree{
+class RBTree: private AllocatorHolder<ALLOC>{
     public:
         typedef RBTreeNodeBase node_base;
         typedef RBTreeNodeBase* node_base_ptr;
@@ -138,21 +138,72 @@ class RBTree{
         typedef VALUE value_type;
         typedef size_t size_type;
         typedef RBTreeIterator<VALUE> iterator;
+        typedef AllocatorTraits<ALLOC> alloc_traits;
     private:
+        typedef AllocatorHolder<ALLOC> holder;
+        using holder::alloc;
+
         node_base header_;
         size_type node_count_;
         key_compare key_compare_;
 
         node_ptr create_node(node_base_ptr parent, node_base_ptr left, node_base_ptr right, const VALUE& value){
-            node_ptr new_node = allocator_type::allocate(1);
-            new(new_node) node(parent, left, right, value);
+            node_ptr new_node = alloc().allocate(1);
+            try{
+                new(new_node) node(parent, left, right, value);
+            }catch(...){
+                alloc().deallocate(new_node, 1);
+                throw;
+            }
             return new_node;
         }
 
         void destroy_node(node_base_ptr p){
             node_ptr node = static_cast<node_ptr>(p);
             node->~node();
-            allocator_type::deallocate(node, 1);
+            alloc().deallocate(node, 1);
+        }
+
+        void init_header(){
+            header_.parent = nullptr;
+            header_.left = &header_;
+            header_.right = &header_;
+            header_.color = RED;
+            node_count_ = 0;
+        }
+
+        // Re-points the nodes of other at header_; this tree must be empty.
+        void steal(RBTree& other){
+            if(other.root() == nullptr) return;
+            header_.parent = other.header_.parent;
+            header_.left = other.header_.left;
+            header_.right = other.header_.right;
+            header_.parent->parent = &header_;
+            node_count_ = other.node_count_;
+            other.init_header();
+        }
+
+        void copy_from(const RBTree& other){
+            if(other.root() != nullptr){
+                node_ptr pool = alloc_traits::allocate_batch(alloc(), other.node_count_);
+                node_base_ptr p = nullptr;
+                try{
+                    p = copy(other.root(), pool);
+                }catch(...){
+                    if(pool != nullptr){
+                        node_ptr last = pool;
+                        size_type n = 1;
+                        while(batch_next(last) != nullptr) last = batch_next(last), ++n;
+                        alloc_traits::deallocate_batch(alloc(), pool, last, n);
+                    }
+                    throw;
+                }
+                header_.parent = p;
+                header_.left = leftmost(p);
+                header_.right = rightmost(p);
+                node_count_ = other.node_count_;
+                p->parent = &header_;
+            }
         }
 
         void rotate_left(node_base_ptr node){
@@ -334,52 +385,97 @@ class RBTree{
             }
         }
 
-        void clear_helper(node_base_ptr node){
-            if(node == nullptr) return;
-            clear_helper(node->left);
-            clear_helper(node->right);
-            destroy_node(node);
+        // Destroys the subtree and chains its nodes for one deallocate_batch().
+        void clear_helper(node_base_ptr p, node_ptr& first, node_ptr& last){
+            if(p == nullptr) return;
+            clear_helper(p->left, first, last);
+            clear_helper(p->right, first, last);
+            node_ptr n = static_cast<node_ptr>(p);
+            n->~node();
+            batch_next(n) = first;
+            first = n;
+            if(last == nullptr) last = n;
         }
 
-        node_base_ptr copy(node_base_ptr p){
+        // Builds the copy out of pool, a chain from allocate_batch(). On an
+        // exception the partial copy is freed and pool keeps the unused nodes.
+        node_base_ptr copy(node_base_ptr p, node_ptr& pool){
             if(p == nullptr) return nullptr;
-            node_base_ptr new_node = create_node(nullptr, nullptr, nullptr, static_cast<node*>(p)->data);
+            node_ptr new_node = pool;
+            pool = batch_next(pool);
+            try{
+                new(new_node) node(nullptr, nullptr, nullptr, static_cast<node*>(p)->data);
+            }catch(...){
+                batch_next(new_node) = pool;
+                pool = new_node;
+                throw;
+            }
             new_node->color = p->color;
-            new_node->left = copy(p->left);
-            new_node->right = copy(p->right);
+            try{
+                new_node->left = copy(p->left, pool);
+                new_node->right = copy(p->right, pool);
+            }catch(...){
+                node_ptr first = nullptr, last = nullptr;
+                clear_helper(new_node, first, last);
+                batch_next(last) = pool;
+                pool = first;
+                throw;
+            }
             if(new_node->left) new_node->left->parent = new_node;
             if(new_node->right) new_node->right->parent = new_node;
             return new_node;
         }
 
     public:
-        RBTree():node_count_(0){
-            header_.parent = nullptr;
-            header_.left = &header_;
-            header_.right = &header_;
-            header_.color = RED;
+        RBTree(){
+            init_header();
+        }
+
+        explicit RBTree(const COMPARE& comp, const ALLOC& alloc = ALLOC()):holder(alloc), key_compare_(comp){
+            init_header();
+        }
+
+        RBTree(const RBTree& other):holder(alloc_traits::select_on_container_copy_construction(other.alloc())), key_compare_(other.key_compare_){
+            init_header();
+            copy_from(other);
+        }
+
+        RBTree(RBTree&& other):holder(std::move(other.alloc())), key_compare_(other.key_compare_){
+            init_header();
+            steal(other);
         }
 
-        RBTree(const RBTree& other){
-            if(other.root() == nullptr){
-                header_.parent = nullptr;
-                header_.left = &header_;
-                header_.right = &header_;
-                node_count_ = 0;
+        RBTree& operator=(const RBTree& other){
+            if(this == &other) return *this;
+            clear();
+            alloc_traits::on_copy_assign(alloc(), other.alloc());
+            key_compare_ = other.key_compare_;
+            copy_from(other);
+            return *this;
+        }
+
+        RBTree& operator=(RBTree&& other){
+            if(this == &other) return *this;
+            clear();
+            key_compare_ = other.key_compare_;
+            if(alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::equal(alloc(), other.alloc())){
+                alloc_traits::on_move_assign(alloc(), other.alloc());
+                steal(other);
             }else{
-                node_base_ptr p = copy(other.root());
-                header_.parent = p;
-                header_.left = leftmost(p);
-                header_.right = rightmost(p);
-                node_count_ = other.node_count_;
-                p->parent = &header_;
+                copy_from(other);
+                other.clear();
             }
+            return *this;
         }
 
         ~RBTree(){
             clear();
         }
 
+        allocator_type get_allocator() const{
+            return alloc();
+        }
+
         iterator begin(){
             return header_.left;
         }
@@ -397,7 +493,9 @@ class RBTree{
         }
 
         void clear(){
-            clear_helper(root());
+            node_ptr first = nullptr, last = nullptr;
+            clear_helper(root(), first, last);
+            alloc_traits::deallocate_batch(alloc(), first, last, node_count_);
             header_.parent = nullptr;
             header_.left = &header_;
             header_.right = &header_;
@@ -405,9 +503,12 @@ class RBTree{
         }
 
         void swap(RBTree& other){
-            std::swap(header_, other.header_);
-            std::swap(node_count_, other.node_count_);
+            RBTree tmp(key_compare_, alloc());
+            tmp.steal(*this);
+            steal(other);
+            other.steal(tmp);
             std::swap(key_compare_, other.key_compare_);
+            alloc_traits::on_swap(alloc(), other.alloc());
         }
 
 
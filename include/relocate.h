@@ -0,0 +1,51 @@
+#ifndef __RELOCATE_H
+#define __RELOCATE_H
+
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+// A type is trivially relocatable when moving an object to new storage and
+// forgetting the old one is the same as copying its bytes. That holds for
+// every trivially copyable type; specialise this for other types (such as
+// ones that only own heap pointers) to opt in.
+template <typename T>
+struct is_trivially_relocatable: std::is_trivially_copyable<T>{};
+
+// Relocation cannot fail for these types, so containers may take apart the
+// old storage while they fill the new one.
+template <typename T>
+struct is_nothrow_relocatable: std::integral_constant<bool,
+    is_trivially_relocatable<T>::value || std::is_nothrow_move_constructible<T>::value>{};
+
+// Moves [first, last) into uninitialised dest and ends the lifetime of the
+// source objects. Only for is_nothrow_relocatable types.
+template <typename T>
+inline T* uninitialized_relocate(T* first, T* last, T* dest){
+    static_assert(is_nothrow_relocatable<T>::value, "use copy-then-destroy for throwing moves");
+    if constexpr(is_trivially_relocatable<T>::value){
+        size_t n = last - first;
+        if(n != 0) std::memcpy(static_cast<void*>(dest), static_cast<const void*>(first), n * sizeof(T));
+        return dest + n;
+    }else{
+        T* result = std::uninitialized_move(first, last, dest);
+        std::destroy(first, last);
+        return result;
+    }
+}
+
+// The fallback for types that are not is_nothrow_relocatable: copies
+// [first, last) into uninitialised dest, or moves it when T cannot be copied,
+// as std::move_if_noexcept does. Either way the source is left in place. If
+// a copy throws it is unchanged; if a move throws, the elements already
+// moved from are valid but unspecified.
+template <typename T>
+inline T* uninitialized_move_if_noexcept(T* first, T* last, T* dest){
+    if constexpr(std::is_copy_constructible<T>::value){
+        return std::uninitialized_copy(first, last, dest);
+    }else{
+        return std::uninitialized_move(first, last, dest);
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,379 @@
+#ifndef __RING_BUFFER_H
+#define __RING_BUFFER_H
+
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "allocator.h"
+#include "relocate.h"
+
+// Slots a DynamicRingBuffer allocates on its first push; it doubles from there.
+#ifndef RING_BUFFER_MIN_CAPACITY
+#define RING_BUFFER_MIN_CAPACITY 16
+#endif
+
+// pos_ counts slots from the start of the array and is wrapped through
+// mask_ only when dereferenced, so iterators add, subtract and compare as
+// plain numbers with no boundary checks. T is const for const_iterator.
+template<typename T>
+class RingIterator{
+    template <typename U> friend class RingIterator;
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef typename std::remove_const<T>::type value_type;
+        typedef T* pointer;
+        typedef T& reference;
+        typedef ptrdiff_t difference_type;
+        typedef RingIterator self;
+
+        RingIterator():slots_(nullptr), mask_(0), pos_(0){}
+        RingIterator(T* slots, size_t mask, size_t pos):slots_(slots), mask_(mask), pos_(pos){}
+        template <typename U, typename = typename std::enable_if<std::is_same<const U, T>::value>::type>
+        RingIterator(const RingIterator<U>& other):slots_(other.slots_), mask_(other.mask_), pos_(other.pos_){}
+
+        reference operator*() const{ return slots_[pos_ & mask_];}
+        pointer operator->() const{ return &slots_[pos_ & mask_];}
+        reference operator[](difference_type off) const{ return slots_[(pos_ + off) & mask_];}
+
+        self& operator++(){ ++pos_; return *this;}
+        self operator++(int){ self tmp = *this; ++pos_; return tmp;}
+        self& operator--(){ --pos_; return *this;}
+        self operator--(int){ self tmp = *this; --pos_; return tmp;}
+        self& operator+=(difference_type off){ pos_ += off; return *this;}
+        self& operator-=(difference_type off){ pos_ -= off; return *this;}
+        self operator+(difference_type off) const{ return self(slots_, mask_, pos_ + off);}
+        self operator-(difference_type off) const{ return self(slots_, mask_, pos_ - off);}
+        friend self operator+(difference_type off, const self& it){ return it + off;}
+        difference_type operator-(const self& other) const{ return difference_type(pos_ - other.pos_);}
+
+        bool operator==(const self& other) const{ return pos_ == other.pos_;}
+        bool operator!=(const self& other) const{ return pos_ != other.pos_;}
+        bool operator<(const self& other) const{ return *this - other < 0;}
+        bool operator>(const self& other) const{ return other < *this;}
+        bool operator<=(const self& other) const{ return !(other < *this);}
+        bool operator>=(const self& other) const{ return !(*this < other);}
+
+    private:
+        T* slots_;
+        size_t mask_;
+        size_t pos_;
+};
+
+// The slots of a RingBuffer: N of them inside the object, so the mask is a
+// constant and nothing is ever allocated.
+template<typename T, size_t N, typename ALLOC>
+class RingStorage{
+    static_assert((N & (N - 1)) == 0, "N must be a power of two");
+    protected:
+        alignas(T) unsigned char buffer_[N * sizeof(T)];
+
+        RingStorage() = default;
+        explicit RingStorage(const ALLOC&){}
+
+        T* slots(){ return reinterpret_cast<T*>(buffer_);}
+        const T* slots() const{ return reinterpret_cast<const T*>(buffer_);}
+
+    public:
+        static constexpr size_t capacity(){ return N;}
+        ALLOC get_allocator() const{ return ALLOC();}
+};
+
+// N == 0: a power-of-two block from ALLOC that RingBuffer doubles when full.
+template<typename T, typename ALLOC>
+class RingStorage<T, 0, ALLOC>: private AllocatorHolder<ALLOC>{
+    typedef AllocatorHolder<ALLOC> holder;
+    protected:
+        T* slots_;
+        size_t capacity_;
+
+        RingStorage():slots_(nullptr), capacity_(0){}
+        explicit RingStorage(const ALLOC& alloc):holder(alloc), slots_(nullptr), capacity_(0){}
+        RingStorage(const RingStorage&) = delete;
+        ~RingStorage(){ deallocate_slots();}
+
+        using holder::alloc;
+
+        T* slots(){ return slots_;}
+        const T* slots() const{ return slots_;}
+
+        void deallocate_slots(){
+            if(slots_ != nullptr) alloc().deallocate(slots_, capacity_);
+            slots_ = nullptr;
+            capacity_ = 0;
+        }
+
+        void swap_slots(RingStorage& other){
+            std::swap(slots_, other.slots_);
+            std::swap(capacity_, other.capacity_);
+        }
+
+    public:
+        size_t capacity() const{ return capacity_;}
+        ALLOC get_allocator() const{ return alloc();}
+};
+
+// A double-ended queue in one contiguous array of power-of-two size: element
+// i lives in slot (head_ + i) & mask, so every access is an add and an and.
+// RingBuffer<T, N> keeps N slots inline and never allocates; pushing into a
+// full one is undefined, so check full() when the bound is not known.
+// DynamicRingBuffer<T> doubles its block when it fills. Either can be the
+// SEQUENCE of a Queue or a Stack.
+template<typename T, size_t N = 0, typename ALLOC = NewAllocator<T>>
+class RingBuffer: private RingStorage<T, N, ALLOC>{
+    typedef RingStorage<T, N, ALLOC> storage;
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef T& reference;
+        typedef const T* const_pointer;
+        typedef const value_type& const_reference;
+        typedef size_t size_type;
+        typedef ptrdiff_t difference_type;
+        typedef RingIterator<T> iterator;
+        typedef RingIterator<const T> const_iterator;
+        typedef ALLOC allocator_type;
+        typedef AllocatorTraits<ALLOC> alloc_traits;
+    private:
+        using storage::slots;
+
+        size_type head_;
+        size_type size_;
+
+        size_type mask() const{ return capacity() - 1;}
+        pointer slot(size_type i){ return slots() + ((head_ + i) & mask());}
+        const_pointer slot(size_type i) const{ return slots() + ((head_ + i) & mask());}
+
+        // Moves the elements, in order, to the start of a new block of
+        // new_cap slots, once construct has built count new elements at
+        // gap in it. If anything throws, the ring is unchanged.
+        template <typename CONSTRUCT>
+        void reallocate(size_type new_cap, size_type gap, size_type count, CONSTRUCT construct){
+            pointer new_slots = this->alloc().allocate(new_cap);
+            try{
+                construct(new_slots + gap);
+            }catch(...){
+                this->alloc().deallocate(new_slots, new_cap);
+                throw;
+            }
+            std::pair<pointer, size_type> first = first_span(), second = second_span();
+            if constexpr(is_nothrow_relocatable<T>::value){
+                uninitialized_relocate(first.first, first.first + first.second, new_slots);
+                uninitialized_relocate(second.first, second.first + second.second, new_slots + first.second);
+            }else{
+                try{
+                    uninitialized_move_if_noexcept(first.first, first.first + first.second, new_slots);
+                    try{
+                        uninitialized_move_if_noexcept(second.first, second.first + second.second, new_slots + first.second);
+                    }catch(...){
+                        std::destroy_n(new_slots, first.second);
+                        throw;
+                    }
+                }catch(...){
+                    std::destroy_n(new_slots + gap, count);
+                    this->alloc().deallocate(new_slots, new_cap);
+                    throw;
+                }
+                std::destroy_n(first.first, first.second);
+                std::destroy_n(second.first, second.second);
+            }
+            this->deallocate_slots();
+            this->slots_ = new_slots;
+            this->capacity_ = new_cap;
+            head_ = 0;
+        }
+
+        size_type grow_capacity() const{
+            static_assert((RING_BUFFER_MIN_CAPACITY & (RING_BUFFER_MIN_CAPACITY - 1)) == 0, "RING_BUFFER_MIN_CAPACITY must be a power of two");
+            return std::max(size_type(RING_BUFFER_MIN_CAPACITY), 2 * capacity());
+        }
+
+        // Growth paths of emplace_back and emplace_front, kept out of line.
+        // The new element is built before the old ones move, since args may
+        // refer to one of them.
+        template <typename... Args>
+        __attribute__((noinline, cold)) pointer realloc_emplace_back(Args&&... args){
+            reallocate(grow_capacity(), size_, 1, [&](pointer gap){ ::new(static_cast<void*>(gap)) T(std::forward<Args>(args)...);});
+            return slots() + size_++;
+        }
+
+        template <typename... Args>
+        __attribute__((noinline, cold)) pointer realloc_emplace_front(Args&&... args){
+            size_type new_cap = grow_capacity();
+            reallocate(new_cap, new_cap - 1, 1, [&](pointer gap){ ::new(static_cast<void*>(gap)) T(std::forward<Args>(args)...);});
+            head_ = new_cap - 1;
+            ++size_;
+            return slots() + head_;
+        }
+
+        void steal(RingBuffer& other){
+            this->swap_slots(other);
+            std::swap(head_, other.head_);
+            std::swap(size_, other.size_);
+        }
+
+        // Moves other's elements to the back of this ring and empties other.
+        void relocate_from(RingBuffer& other){
+            if constexpr(N == 0) reserve(size_ + other.size_);
+            for(size_type i = 0; i < other.size_; i++) emplace_back(std::move(*other.slot(i)));
+            other.clear();
+        }
+
+    public:
+        using storage::capacity;
+        using storage::get_allocator;
+
+        RingBuffer():head_(0), size_(0){}
+        explicit RingBuffer(const ALLOC& alloc):storage(alloc), head_(0), size_(0){}
+        RingBuffer(const RingBuffer& other):storage(alloc_traits::select_on_container_copy_construction(other.get_allocator())), head_(0), size_(0){
+            if constexpr(N == 0) reserve(other.size_);
+            try{
+                for(size_type i = 0; i < other.size_; i++) emplace_back(*other.slot(i));
+            }catch(...){
+                clear();
+                throw;
+            }
+        }
+        RingBuffer(RingBuffer&& other):storage(other.get_allocator()), head_(0), size_(0){
+            if constexpr(N == 0) steal(other);
+            else relocate_from(other);
+        }
+        ~RingBuffer(){ clear();}
+
+        RingBuffer& operator=(const RingBuffer& other){
+            if(this != &other){
+                RingBuffer tmp(other);
+                clear();
+                relocate_from(tmp);
+            }
+            return *this;
+        }
+        RingBuffer& operator=(RingBuffer&& other){
+            if(this == &other) return *this;
+            clear();
+            if constexpr(N == 0){
+                if(alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::equal(this->alloc(), other.alloc())){
+                    this->deallocate_slots();
+                    alloc_traits::on_move_assign(this->alloc(), other.alloc());
+                    steal(other);
+                    return *this;
+                }
+            }
+            relocate_from(other);
+            return *this;
+        }
+
+        iterator begin(){ return iterator(slots(), mask(), head_);}
+        iterator end(){ return iterator(slots(), mask(), head_ + size_);}
+        const_iterator begin() const{ return const_iterator(slots(), mask(), head_);}
+        const_iterator end() const{ return const_iterator(slots(), mask(), head_ + size_);}
+        size_type size() const{ return size_;}
+        bool empty() const{ return size_ == 0;}
+        bool full() const{ return size_ == capacity();}
+        reference front(){ return *slot(0);}
+        reference back(){ return *slot(size_ - 1);}
+        const_reference front() const{ return *slot(0);}
+        const_reference back() const{ return *slot(size_ - 1);}
+        reference operator[]( size_type pos ){ return *slot(pos);}
+        const_reference operator[]( size_type pos ) const{ return *slot(pos);}
+
+        // The elements as two contiguous arrays, front to back. The second
+        // is empty unless the elements wrap past the end of the slots.
+        std::pair<pointer, size_type> first_span(){
+            return std::make_pair(slots() + head_, std::min(size_, capacity() - head_));
+        }
+        std::pair<pointer, size_type> second_span(){
+            return std::make_pair(slots(), size_ - std::min(size_, capacity() - head_));
+        }
+        std::pair<const_pointer, size_type> first_span() const{
+            return std::make_pair(slots() + head_, std::min(size_, capacity() - head_));
+        }
+        std::pair<const_pointer, size_type> second_span() const{
+            return std::make_pair(slots(), size_ - std::min(size_, capacity() - head_));
+        }
+
+        void clear(){
+            std::pair<pointer, size_type> first = first_span(), second = second_span();
+            std::destroy_n(first.first, first.second);
+            std::destroy_n(second.first, second.second);
+            head_ = 0;
+            size_ = 0;
+        }
+
+        // DynamicRingBuffer only: makes room for new_cap elements, rounded
+        // up to a power of two.
+        void reserve( size_type new_cap ){
+            static_assert(N == 0, "a fixed RingBuffer cannot grow");
+            if(new_cap <= capacity()) return;
+            size_type cap = RING_BUFFER_MIN_CAPACITY;
+            while(cap < new_cap) cap *= 2;
+            reallocate(cap, 0, 0, [](pointer){});
+        }
+
+        template <typename... Args>
+        reference emplace_back( Args&&... args ){
+            if constexpr(N == 0){
+                if(size_ == capacity()) return *realloc_emplace_back(std::forward<Args>(args)...);
+            }
+            pointer p = slot(size_);
+            ::new(static_cast<void*>(p)) T(std::forward<Args>(args)...);
+            ++size_;
+            return *p;
+        }
+
+        template <typename... Args>
+        reference emplace_front( Args&&... args ){
+            if constexpr(N == 0){
+                if(size_ == capacity()) return *realloc_emplace_front(std::forward<Args>(args)...);
+            }
+            size_type head = (head_ - 1) & mask();
+            pointer p = slots() + head;
+            ::new(static_cast<void*>(p)) T(std::forward<Args>(args)...);
+            head_ = head;
+            ++size_;
+            return *p;
+        }
+
+        void push_back( const T& value ){ emplace_back(value);}
+        void push_back( T&& value ){ emplace_back(std::move(value));}
+        void push_front( const T& value ){ emplace_front(value);}
+        void push_front( T&& value ){ emplace_front(std::move(value));}
+
+        void pop_front(){
+            std::destroy_at(slot(0));
+            head_ = (head_ + 1) & mask();
+            --size_;
+        }
+
+        void pop_back(){
+            std::destroy_at(slot(size_ - 1));
+            --size_;
+        }
+
+        void swap( RingBuffer& other ){
+            if constexpr(N == 0){
+                steal(other);
+                alloc_traits::on_swap(this->alloc(), other.alloc());
+            }else{
+                RingBuffer tmp(std::move(other));
+                other = std::move(*this);
+                *this = std::move(tmp);
+            }
+        }
+
+        void show() const{
+            for(const_iterator it = begin(); it != end(); ++it){
+                std::cout << *it << ' ';
+            }
+            std::cout << std::endl;
+            std::cout << "size = " << size_ << " capacity = " << capacity() << std::endl;
+        }
+};
+
+template<typename T, typename ALLOC = NewAllocator<T>>
+using DynamicRingBuffer = RingBuffer<T, 0, ALLOC>;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,237 @@
+#ifndef __SIMD_H
+#define __SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <algorithm>
+
+// Bulk kernels over arrays of arithmetic values. Each kernel is written once
+// against GCC vector extensions and compiled three times: 32-byte vectors in
+// an AVX2 function, 16-byte vectors in an SSE2 function and one-lane vectors
+// as the scalar fallback. simd_level() picks one at run time.
+
+#define SIMD_INLINE inline __attribute__((always_inline))
+
+// The 32-byte kernels only ever run inlined into AVX2 functions.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+enum SimdLevel{ SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+
+inline SimdLevel simd_detect(){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+    if(__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+#endif
+    return SIMD_SCALAR;
+}
+
+inline SimdLevel& simd_level_ref(){
+    static SimdLevel level = simd_detect();
+    return level;
+}
+
+inline SimdLevel simd_level(){ return simd_level_ref();}
+
+// Forces a lower level, e.g. to compare kernels; never raises it past what
+// the CPU supports.
+inline void simd_set_level(SimdLevel level){
+    simd_level_ref() = std::min(level, simd_detect());
+}
+
+template <typename T>
+struct simd_supported: std::integral_constant<bool,
+    std::is_arithmetic<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, long double>::value>{};
+
+template <typename T, size_t W>
+struct simd_vec{
+    typedef T type __attribute__((vector_size(W)));
+    typedef decltype(type{} == type{}) mask;
+    enum{ LANES = W / sizeof(T) };
+};
+
+template <typename V, typename T>
+SIMD_INLINE V simd_load(const T* p){
+    V v;
+    std::memcpy(&v, p, sizeof(V));
+    return v;
+}
+
+template <typename V, typename T>
+SIMD_INLINE void simd_store(T* p, const V& v){
+    std::memcpy(p, &v, sizeof(V));
+}
+
+template <typename M>
+SIMD_INLINE bool simd_any(const M& m){
+    if constexpr(sizeof(M) % 8 == 0){
+        uint64_t words[sizeof(M) / 8];
+        std::memcpy(words, &m, sizeof(M));
+        uint64_t acc = 0;
+        for(size_t i = 0; i < sizeof(M) / 8; i++) acc |= words[i];
+        return acc != 0;
+    }else{
+        return m[0] != 0;
+    }
+}
+
+template <typename T, size_t W>
+SIMD_INLINE size_t simd_find_kernel(const T* p, size_t n, T value){
+    typedef simd_vec<T, W> sv;
+    typename sv::type target = typename sv::type{} + value;
+    size_t i = 0;
+    for(; i + sv::LANES <= n; i += sv::LANES){
+        if(simd_any(simd_load<typename sv::type>(p + i) == target)) break;
+    }
+    for(; i < n; i++) if(p[i] == value) return i;
+    return n;
+}
+
+template <typename T, size_t W>
+SIMD_INLINE size_t simd_count_kernel(const T* p, size_t n, T value){
+    typedef simd_vec<T, W> sv;
+    // Lanes count matches as -1 each; drain them before they can overflow.
+    const size_t FLUSH = (size_t(1) << (8 * sizeof(T) - 1)) - 1;
+    typename sv::type target = typename sv::type{} + value;
+    size_t count = 0, i = 0;
+    while(i + sv::LANES <= n){
+        typename sv::mask acc = {};
+        for(size_t k = 0; k < FLUSH && i + sv::LANES <= n; k++, i += sv::LANES){
+            acc -= (simd_load<typename sv::type>(p + i) == target);
+        }
+        for(size_t l = 0; l < sv::LANES; l++) count += acc[l];
+    }
+    for(; i < n; i++) count += (p[i] == value);
+    return count;
+}
+
+// n must be at least 1.
+template <typename T, size_t W, bool MIN>
+SIMD_INLINE T simd_minmax_kernel(const T* p, size_t n){
+    typedef simd_vec<T, W> sv;
+    T result = p[0];
+    size_t i = 0;
+    if(n >= sv::LANES){
+        typename sv::type acc = simd_load<typename sv::type>(p);
+        for(i = sv::LANES; i + sv::LANES <= n; i += sv::LANES){
+            typename sv::type v = simd_load<typename sv::type>(p + i);
+            acc = MIN? (v < acc? v : acc) : (v > acc? v : acc);
+        }
+        for(size_t l = 0; l < sv::LANES; l++){
+            if(MIN? acc[l] < result : acc[l] > result) result = acc[l];
+        }
+    }
+    for(; i < n; i++){
+        if(MIN? p[i] < result : p[i] > result) result = p[i];
+    }
+    return result;
+}
+
+template <typename T, size_t W>
+SIMD_INLINE T simd_sum_kernel(const T* p, size_t n){
+    typedef simd_vec<T, W> sv;
+    typename sv::type acc = {};
+    size_t i = 0;
+    for(; i + sv::LANES <= n; i += sv::LANES) acc += simd_load<typename sv::type>(p + i);
+    T sum = 0;
+    for(size_t l = 0; l < sv::LANES; l++) sum += acc[l];
+    for(; i < n; i++) sum += p[i];
+    return sum;
+}
+
+template <typename T, size_t W>
+SIMD_INLINE T simd_dot_kernel(const T* a, const T* b, size_t n){
+    typedef simd_vec<T, W> sv;
+    typename sv::type acc = {};
+    size_t i = 0;
+    for(; i + sv::LANES <= n; i += sv::LANES){
+        acc += simd_load<typename sv::type>(a + i) * simd_load<typename sv::type>(b + i);
+    }
+    T sum = 0;
+    for(size_t l = 0; l < sv::LANES; l++) sum += acc[l];
+    for(; i < n; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+template <typename T, size_t W>
+SIMD_INLINE void simd_fill_kernel(T* p, size_t n, T value){
+    typedef simd_vec<T, W> sv;
+    typename sv::type v = typename sv::type{} + value;
+    size_t i = 0;
+    for(; i + sv::LANES <= n; i += sv::LANES) simd_store(p + i, v);
+    for(; i < n; i++) p[i] = value;
+}
+
+template <typename T, size_t W>
+SIMD_INLINE bool simd_equal_kernel(const T* a, const T* b, size_t n){
+    typedef simd_vec<T, W> sv;
+    size_t i = 0;
+    for(; i + sv::LANES <= n; i += sv::LANES){
+        if(simd_any(simd_load<typename sv::type>(a + i) != simd_load<typename sv::type>(b + i))) return false;
+    }
+    for(; i < n; i++) if(!(a[i] == b[i])) return false;
+    return true;
+}
+
+template <typename T, size_t W>
+SIMD_INLINE void simd_add_kernel(T* dst, const T* src, size_t n){
+    typedef simd_vec<T, W> sv;
+    size_t i = 0;
+    for(; i + sv::LANES <= n; i += sv::LANES){
+        simd_store(dst + i, simd_load<typename sv::type>(dst + i) + simd_load<typename sv::type>(src + i));
+    }
+    for(; i < n; i++) dst[i] += src[i];
+}
+
+template <typename T, size_t W>
+SIMD_INLINE void simd_scale_kernel(T* p, size_t n, T factor){
+    typedef simd_vec<T, W> sv;
+    typename sv::type f = typename sv::type{} + factor;
+    size_t i = 0;
+    for(; i + sv::LANES <= n; i += sv::LANES) simd_store(p + i, simd_load<typename sv::type>(p + i) * f);
+    for(; i < n; i++) p[i] *= factor;
+}
+
+// Defines simd_<NAME>_avx2, simd_<NAME>_sse2 and the dispatching simd_<NAME>.
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_DISPATCH(RET, NAME, KERNEL, PARAMS, ARGS) \
+    template <typename T> __attribute__((target("avx2"))) RET simd_##NAME##_avx2 PARAMS{ return KERNEL<T, 32>ARGS;} \
+    template <typename T> __attribute__((target("sse2"))) RET simd_##NAME##_sse2 PARAMS{ return KERNEL<T, 16>ARGS;} \
+    template <typename T> inline RET simd_##NAME PARAMS{ \
+        static_assert(simd_supported<T>::value, "simd kernels need an arithmetic element type"); \
+        switch(simd_level()){ \
+            case SIMD_AVX2: return simd_##NAME##_avx2<T>ARGS; \
+            case SIMD_SSE2: return simd_##NAME##_sse2<T>ARGS; \
+            default: return KERNEL<T, sizeof(T)>ARGS; \
+        } \
+    }
+#else
+#define SIMD_DISPATCH(RET, NAME, KERNEL, PARAMS, ARGS) \
+    template <typename T> inline RET simd_##NAME PARAMS{ \
+        static_assert(simd_supported<T>::value, "simd kernels need an arithmetic element type"); \
+        return KERNEL<T, sizeof(T)>ARGS; \
+    }
+#endif
+
+template <typename T, size_t W> SIMD_INLINE T simd_min_kernel(const T* p, size_t n){ return simd_minmax_kernel<T, W, true>(p, n);}
+template <typename T, size_t W> SIMD_INLINE T simd_max_kernel(const T* p, size_t n){ return simd_minmax_kernel<T, W, false>(p, n);}
+
+SIMD_DISPATCH(size_t, find, simd_find_kernel, (const T* p, size_t n, T value), (p, n, value))
+SIMD_DISPATCH(size_t, count, simd_count_kernel, (const T* p, size_t n, T value), (p, n, value))
+SIMD_DISPATCH(T, min, simd_min_kernel, (const T* p, size_t n), (p, n))
+SIMD_DISPATCH(T, max, simd_max_kernel, (const T* p, size_t n), (p, n))
+SIMD_DISPATCH(T, sum, simd_sum_kernel, (const T* p, size_t n), (p, n))
+SIMD_DISPATCH(T, dot, simd_dot_kernel, (const T* a, const T* b, size_t n), (a, b, n))
+SIMD_DISPATCH(void, fill, simd_fill_kernel, (T* p, size_t n, T value), (p, n, value))
+SIMD_DISPATCH(bool, equal, simd_equal_kernel, (const T* a, const T* b, size_t n), (a, b, n))
+SIMD_DISPATCH(void, add, simd_add_kernel, (T* dst, const T* src, size_t n), (dst, src, n))
+SIMD_DISPATCH(void, scale, simd_scale_kernel, (T* p, size_t n, T factor), (p, n, factor))
+
+#undef SIMD_DISPATCH
+
+#pragma GCC diagnostic pop
+
+#endif
\ No newline at end of file
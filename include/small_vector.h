@@ -0,0 +1,171 @@
+#ifndef __SMALL_VECTOR_H
+#define __SMALL_VECTOR_H
+
+#include <memory>
+#include <iterator>
+
+#include "vector.h"
+
+// A Vector that keeps its first N elements inside the object and only asks
+// ALLOC for storage once it outgrows them. Everything but construction,
+// assignment and swapping is VectorBase's.
+template<typename T, size_t N, typename ALLOC = NewAllocator<T>>
+class SmallVector: public VectorBase<T, ALLOC, SmallVector<T, N, ALLOC>>{
+    static_assert(N > 0, "use Vector for N == 0");
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef T& reference;
+        typedef const T* const_pointer;
+        typedef const value_type& const_reference;
+        typedef size_t size_type;
+        typedef pointer iterator;
+        typedef const_pointer const_iterator;
+        typedef SmallVector<T, N, ALLOC> Self;
+        typedef ALLOC allocator_type;
+        typedef AllocatorTraits<ALLOC> alloc_traits;
+        enum{ INLINE_CAPACITY = N };
+    private:
+        typedef VectorBase<T, ALLOC, SmallVector> base;
+        friend base;
+
+        using base::start_;
+        using base::finish_;
+        using base::end_of_storage_;
+        using base::alloc;
+        using base::reallocate;
+
+        alignas(T) unsigned char buffer_[N * sizeof(T)];
+
+        pointer inline_data(){ return reinterpret_cast<pointer>(buffer_);}
+        void reset_inline(){ start_ = finish_ = inline_data(); end_of_storage_ = start_ + N;}
+
+        void deallocate_storage(){
+            if(!is_inline()) alloc().deallocate(start_, capacity());
+        }
+
+        // Takes other's elements: its heap block if it has one, otherwise
+        // relocates the inline elements. other is left empty and inline.
+        void steal(SmallVector& other){
+            if(other.is_inline()){
+                reset_inline();
+                relocate_from(other);
+            }else{
+                start_ = other.start_;
+                finish_ = other.finish_;
+                end_of_storage_ = other.end_of_storage_;
+                other.reset_inline();
+            }
+        }
+
+        // Moves other's elements into the (empty) storage we already own.
+        void relocate_from(SmallVector& other){
+            size_type n = other.size();
+            if(n > capacity()) reallocate(n, end(), 0, [](pointer){});
+            if constexpr(is_nothrow_relocatable<T>::value){
+                uninitialized_relocate(other.start_, other.finish_, start_);
+            }else{
+                uninitialized_move_if_noexcept(other.start_, other.finish_, start_);
+                std::destroy(other.start_, other.finish_);
+            }
+            finish_ = start_ + n;
+            other.finish_ = other.start_;
+        }
+
+    public:
+        using base::begin;
+        using base::end;
+        using base::size;
+        using base::capacity;
+        using base::clear;
+        using base::reserve;
+        using base::insert;
+
+        SmallVector(){ reset_inline();}
+        explicit SmallVector(const ALLOC& alloc):base(alloc){ reset_inline();}
+        SmallVector(size_type n, const_reference value = value_type(), const ALLOC& alloc = ALLOC()):base(alloc){
+            reset_inline();
+            insert(end(), n, value);
+        }
+        template< class InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category >
+        SmallVector( InputIt first, InputIt last, const ALLOC& alloc = ALLOC()):base(alloc){
+            reset_inline();
+            this->init_range(first, last);
+        }
+        SmallVector(const SmallVector& other):SmallVector(other.begin(), other.end(), alloc_traits::select_on_container_copy_construction(other.alloc())){}
+        SmallVector(const SmallVector& other, const ALLOC& alloc):SmallVector(other.begin(), other.end(), alloc){}
+        SmallVector(SmallVector&& other):base(std::move(other.alloc())){
+            steal(other);
+        }
+        SmallVector(SmallVector&& other, const ALLOC& alloc):base(alloc){
+            reset_inline();
+            if(!other.is_inline() && alloc_traits::equal(this->alloc(), other.alloc())) steal(other);
+            else relocate_from(other);
+        }
+        ~SmallVector(){
+            std::destroy(start_, finish_);
+            deallocate_storage();
+        }
+        bool is_inline() const { return start_ == reinterpret_cast<const_pointer>(buffer_);}
+
+        SmallVector& operator=(const SmallVector& other){
+            if(this == &other) return *this;
+            if(alloc_traits::propagate_on_container_copy_assignment::value && !alloc_traits::equal(alloc(), other.alloc())){
+                clear();
+                deallocate_storage();
+                reset_inline();
+            }
+            alloc_traits::on_copy_assign(alloc(), other.alloc());
+            if(other.size() > capacity()){
+                clear();
+                reserve(other.size());
+                finish_ = std::uninitialized_copy(other.begin(), other.end(), start_);
+            }else if(other.size() > size()){
+                std::copy(other.begin(), other.begin() + size(), start_);
+                finish_ = std::uninitialized_copy(other.begin() + size(), other.end(), finish_);
+            }else{
+                pointer new_finish = std::copy(other.begin(), other.end(), start_);
+                std::destroy(new_finish, end());
+                finish_ = new_finish;
+            }
+            return *this;
+        }
+        SmallVector& operator=(SmallVector&& other){
+            if(this == &other) return *this;
+            clear();
+            if(!other.is_inline() && (alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::equal(alloc(), other.alloc()))){
+                deallocate_storage();
+                alloc_traits::on_move_assign(alloc(), other.alloc());
+                steal(other);
+            }else{
+                relocate_from(other);
+            }
+            return *this;
+        }
+
+        void swap( SmallVector& other ){
+            if(!is_inline() && !other.is_inline()){
+                std::swap(start_, other.start_);
+                std::swap(finish_, other.finish_);
+                std::swap(end_of_storage_, other.end_of_storage_);
+                alloc_traits::on_swap(alloc(), other.alloc());
+            }else{
+                SmallVector tmp(std::move(other));
+                other = std::move(*this);
+                *this = std::move(tmp);
+            }
+        }
+
+        void show() const{
+            for(auto &x : *this){
+                std::cout << x << " ";
+            }
+            std::cout << std::endl;
+            std::cout<<"size: "<<size()<<' '
+                     <<"capacity: "<<capacity()<<' '
+                     <<(is_inline()? "inline" : "heap")<<std::endl;
+        }
+
+};
+
+#endif
\ No newline at end of file
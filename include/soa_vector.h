@@ -0,0 +1,376 @@
+#ifndef __SOA_VECTOR_H
+#define __SOA_VECTOR_H
+
+#include <memory>
+#include <iterator>
+#include <tuple>
+#include <array>
+#include <utility>
+
+#include "allocator.h"
+#include "relocate.h"
+
+template <typename SOA, typename REF>
+struct SoaIterator{
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef typename SOA::value_type value_type;
+    typedef REF reference;
+    typedef void pointer;
+    typedef ptrdiff_t difference_type;
+    typedef SoaIterator self;
+
+    SOA* soa_;
+    size_t row_;
+
+    SoaIterator():soa_(nullptr), row_(0){}
+    SoaIterator(SOA* soa, size_t row):soa_(soa), row_(row){}
+
+    reference operator*() const{ return (*soa_)[row_];}
+    reference operator[](difference_type off) const{ return (*soa_)[row_ + off];}
+
+    self& operator++(){ ++row_; return *this;}
+    self operator++(int){ self tmp = *this; ++row_; return tmp;}
+    self& operator--(){ --row_; return *this;}
+    self operator--(int){ self tmp = *this; --row_; return tmp;}
+    self& operator+=(difference_type off){ row_ += off; return *this;}
+    self& operator-=(difference_type off){ row_ -= off; return *this;}
+    self operator+(difference_type off) const{ return self(soa_, row_ + off);}
+    self operator-(difference_type off) const{ return self(soa_, row_ - off);}
+    difference_type operator-(const self& other) const{ return difference_type(row_) - difference_type(other.row_);}
+
+    bool operator==(const self& other) const{ return row_ == other.row_;}
+    bool operator!=(const self& other) const{ return row_ != other.row_;}
+    bool operator<(const self& other) const{ return row_ < other.row_;}
+    bool operator>(const self& other) const{ return row_ > other.row_;}
+    bool operator<=(const self& other) const{ return row_ <= other.row_;}
+    bool operator>=(const self& other) const{ return row_ >= other.row_;}
+};
+
+// Columns start on boundaries of the largest of a cache line and every
+// field's alignment.
+template <typename... Fields>
+struct soa_column_align: std::integral_constant<size_t, std::max({size_t(CACHE_LINE_SIZE), alignof(Fields)...})>{};
+
+// The unit a SoaVector block is allocated in, so that ALLOC's alignof
+// guarantee lines the columns up.
+template <size_t ALIGN>
+struct alignas(ALIGN) SoaLine{
+    unsigned char bytes[ALIGN];
+};
+
+// Stores each field in its own column so loops over a few fields only pull
+// in those fields' cache lines. All columns share one cache-line aligned
+// block, one size and one capacity; rows are read and written through
+// tuples of references. The block comes from ALLOC<SoaLine<...>>;
+// SoaVector<Fields...> uses NewAllocator.
+template <template<typename> class ALLOC, typename... Fields>
+class BasicSoaVector: private AllocatorHolder<ALLOC<SoaLine<soa_column_align<Fields...>::value>>>{
+    static_assert(sizeof...(Fields) > 0, "SoaVector needs at least one field");
+    public:
+        typedef std::tuple<Fields...> value_type;
+        typedef std::tuple<Fields&...> reference;
+        typedef std::tuple<const Fields&...> const_reference;
+        typedef size_t size_type;
+        typedef SoaIterator<BasicSoaVector, reference> iterator;
+        typedef SoaIterator<const BasicSoaVector, const_reference> const_iterator;
+        typedef SoaLine<soa_column_align<Fields...>::value> line_type;
+        typedef ALLOC<line_type> allocator_type;
+        typedef AllocatorTraits<allocator_type> alloc_traits;
+        template <size_t I>
+        using field_type = typename std::tuple_element<I, value_type>::type;
+        enum{ FIELD_NR = sizeof...(Fields) };
+        enum{ COLUMN_ALIGN = soa_column_align<Fields...>::value };
+    private:
+        typedef AllocatorHolder<allocator_type> holder;
+        typedef std::tuple<Fields*...> columns;
+        typedef std::index_sequence_for<Fields...> indices;
+        typedef std::integral_constant<bool, (is_nothrow_relocatable<Fields>::value && ...)> relocatable;
+
+        columns columns_;
+        char* block_;
+        size_type size_;
+        size_type capacity_;
+
+        // Byte offset of each column in a block of cap rows, and the total.
+        static std::array<size_t, FIELD_NR + 1> offsets(size_type cap){
+            const size_t sizes[] = { sizeof(Fields)... };
+            std::array<size_t, FIELD_NR + 1> off;
+            size_t bytes = 0;
+            for(size_t i = 0; i < FIELD_NR; i++){
+                bytes = (bytes + COLUMN_ALIGN - 1) & ~size_t(COLUMN_ALIGN - 1);
+                off[i] = bytes;
+                bytes += cap * sizes[i];
+            }
+            off[FIELD_NR] = bytes;
+            return off;
+        }
+
+        template <size_t... I>
+        static columns columns_at(char* block, const std::array<size_t, FIELD_NR + 1>& off, std::index_sequence<I...>){
+            return columns(reinterpret_cast<field_type<I>*>(block + off[I])...);
+        }
+
+        using holder::alloc;
+
+        static size_type line_nr(size_type cap){
+            return (offsets(cap)[FIELD_NR] + COLUMN_ALIGN - 1) / COLUMN_ALIGN;
+        }
+
+        void deallocate_block(char* block, size_type cap){
+            alloc().deallocate(reinterpret_cast<line_type*>(block), line_nr(cap));
+        }
+
+        void release_block(){
+            if(block_ != nullptr) deallocate_block(block_, capacity_);
+            block_ = nullptr;
+        }
+
+        void destroy_rows(size_type first, size_type last){
+            std::apply([&](Fields*... cols){ (std::destroy(cols + first, cols + last), ...);}, columns_);
+        }
+
+        // Builds row from args one field at a time, undoing earlier fields
+        // if a later constructor throws.
+        template <size_t I, typename TUPLE>
+        void construct_row(size_type row, TUPLE&& args){
+            if constexpr(I < FIELD_NR){
+                field_type<I>* p = std::get<I>(columns_) + row;
+                ::new(static_cast<void*>(p)) field_type<I>(std::get<I>(std::forward<TUPLE>(args)));
+                try{
+                    construct_row<I + 1>(row, std::forward<TUPLE>(args));
+                }catch(...){
+                    std::destroy_at(p);
+                    throw;
+                }
+            }
+        }
+
+        // Copies the first n rows of src into the empty columns dst. With
+        // MOVE_IF_NOEXCEPT, fields that cannot be copied are moved instead.
+        template <size_t I, bool MOVE_IF_NOEXCEPT = false>
+        static void copy_columns(const columns& src, const columns& dst, size_type n){
+            if constexpr(I < FIELD_NR){
+                field_type<I>* from = std::get<I>(src);
+                field_type<I>* to = std::get<I>(dst);
+                if constexpr(MOVE_IF_NOEXCEPT) uninitialized_move_if_noexcept(from, from + n, to);
+                else std::uninitialized_copy(from, from + n, to);
+                try{
+                    copy_columns<I + 1, MOVE_IF_NOEXCEPT>(src, dst, n);
+                }catch(...){
+                    std::destroy(to, to + n);
+                    throw;
+                }
+            }
+        }
+
+        // One growth step for every column: a new block, then each column
+        // relocated into it, or copied (moved if it cannot be copied) when
+        // some field's move may throw.
+        void reallocate(size_type new_cap){
+            std::array<size_t, FIELD_NR + 1> off = offsets(new_cap);
+            char* block = reinterpret_cast<char*>(alloc().allocate(line_nr(new_cap)));
+            columns cols = columns_at(block, off, indices());
+            if constexpr(relocatable::value){
+                std::apply([&](Fields*... from){
+                    std::apply([&](Fields*... to){ (uninitialized_relocate(from, from + size_, to), ...);}, cols);
+                }, columns_);
+            }else{
+                try{
+                    copy_columns<0, true>(columns_, cols, size_);
+                }catch(...){
+                    deallocate_block(block, new_cap);
+                    throw;
+                }
+                destroy_rows(0, size_);
+            }
+            release_block();
+            block_ = block;
+            columns_ = cols;
+            capacity_ = new_cap;
+        }
+
+        size_type grow_capacity(size_type count) const{
+            return std::max(2 * capacity_, size_ + count);
+        }
+
+        template <typename... Args>
+        __attribute__((noinline, cold)) void realloc_emplace_back(Args&&... args){
+            // The arguments may be rows of this vector, so copy them out first.
+            value_type tmp(std::forward<Args>(args)...);
+            reallocate(grow_capacity(1));
+            construct_row<0>(size_, std::move(tmp));
+            ++size_;
+        }
+
+        void steal(BasicSoaVector& other){
+            columns_ = other.columns_;
+            block_ = other.block_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.columns_ = columns();
+            other.block_ = nullptr;
+            other.size_ = other.capacity_ = 0;
+        }
+
+        void swap_storage(BasicSoaVector& other){
+            std::swap(columns_, other.columns_);
+            std::swap(block_, other.block_);
+            std::swap(size_, other.size_);
+            std::swap(capacity_, other.capacity_);
+        }
+
+    public:
+        BasicSoaVector():columns_(), block_(nullptr), size_(0), capacity_(0){}
+
+        explicit BasicSoaVector(const allocator_type& alloc):holder(alloc), columns_(), block_(nullptr), size_(0), capacity_(0){}
+
+        // These delegate, so the destructor cleans up if the body throws.
+        explicit BasicSoaVector(size_type n, const value_type& value = value_type(), const allocator_type& alloc = allocator_type()):BasicSoaVector(alloc){
+            resize(n, value);
+        }
+
+        BasicSoaVector(const BasicSoaVector& other, const allocator_type& alloc):BasicSoaVector(alloc){
+            reserve(other.size_);
+            copy_columns<0>(other.columns_, columns_, other.size_);
+            size_ = other.size_;
+        }
+
+        BasicSoaVector(const BasicSoaVector& other):BasicSoaVector(other, alloc_traits::select_on_container_copy_construction(other.alloc())){}
+
+        BasicSoaVector(BasicSoaVector&& other):holder(std::move(other.alloc())), columns_(), block_(nullptr), size_(0), capacity_(0){
+            steal(other);
+        }
+
+        BasicSoaVector& operator=(const BasicSoaVector& other){
+            if(this != &other){
+                allocator_type new_alloc = alloc();
+                alloc_traits::on_copy_assign(new_alloc, other.alloc());
+                BasicSoaVector tmp(other, new_alloc);
+                swap_storage(tmp);
+                std::swap(alloc(), tmp.alloc());
+            }
+            return *this;
+        }
+
+        // Takes other's block when the allocators allow it, and otherwise
+        // moves the rows into storage from our own allocator.
+        BasicSoaVector& operator=(BasicSoaVector&& other){
+            if(this == &other) return *this;
+            clear();
+            if(alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::equal(alloc(), other.alloc())){
+                release_block();
+                alloc_traits::on_move_assign(alloc(), other.alloc());
+                steal(other);
+            }else{
+                reserve(other.size_);
+                for(size_type row = 0; row < other.size_; row++){
+                    std::apply([this](Fields&... fields){ emplace_back(std::move(fields)...);}, other[row]);
+                }
+                other.clear();
+            }
+            return *this;
+        }
+
+        ~BasicSoaVector(){
+            clear();
+            release_block();
+        }
+
+        void swap(BasicSoaVector& other){
+            swap_storage(other);
+            alloc_traits::on_swap(alloc(), other.alloc());
+        }
+
+        allocator_type get_allocator() const{ return alloc();}
+
+        size_type size() const { return size_;}
+        size_type capacity() const { return capacity_;}
+        bool empty() const { return size_ == 0;}
+
+        iterator begin() { return iterator(this, 0);}
+        iterator end() { return iterator(this, size_);}
+        const_iterator begin() const { return const_iterator(this, 0);}
+        const_iterator end() const { return const_iterator(this, size_);}
+
+        // The contiguous column of field I, size() elements long.
+        template <size_t I>
+        field_type<I>* column() { return std::get<I>(columns_);}
+        template <size_t I>
+        const field_type<I>* column() const { return std::get<I>(columns_);}
+
+        template <size_t I>
+        field_type<I>& get( size_type row ){ return std::get<I>(columns_)[row];}
+
+        reference operator[]( size_type row ){
+            return std::apply([row](Fields*... cols){ return reference(cols[row]...);}, columns_);
+        }
+        const_reference operator[]( size_type row ) const{
+            return std::apply([row](Fields*... cols){ return const_reference(cols[row]...);}, columns_);
+        }
+        reference front() { return (*this)[0];}
+        reference back() { return (*this)[size_ - 1];}
+
+        void reserve( size_type new_cap ){
+            if(new_cap > capacity_) reallocate(new_cap);
+        }
+
+        // Takes one argument per field.
+        template <typename... Args>
+        reference emplace_back( Args&&... args ){
+            static_assert(sizeof...(Args) == FIELD_NR, "emplace_back takes one value per field");
+            if(size_ == capacity_){
+                realloc_emplace_back(std::forward<Args>(args)...);
+            }else{
+                construct_row<0>(size_, std::forward_as_tuple(std::forward<Args>(args)...));
+                ++size_;
+            }
+            return back();
+        }
+
+        void push_back( const value_type& value ){
+            std::apply([this](const Fields&... fields){ emplace_back(fields...);}, value);
+        }
+
+        void push_back( value_type&& value ){
+            std::apply([this](Fields&... fields){ emplace_back(std::move(fields)...);}, value);
+        }
+
+        void pop_back(){
+            destroy_rows(size_ - 1, size_);
+            --size_;
+        }
+
+        void clear(){
+            destroy_rows(0, size_);
+            size_ = 0;
+        }
+
+        void resize( size_type count, const value_type& value = value_type() ){
+            if(count > size_){
+                reserve(count);
+                while(size_ < count) push_back(value);
+            }else{
+                destroy_rows(count, size_);
+                size_ = count;
+            }
+        }
+
+        void show() const{
+            for(size_type row = 0; row < size_; row++){
+                std::cout << '(';
+                std::apply([](const Fields&... fields){
+                    const char* sep = "";
+                    ((std::cout << sep << fields, sep = ", "), ...);
+                }, (*this)[row]);
+                std::cout << ") ";
+            }
+            std::cout << std::endl;
+            std::cout<<"size: "<<size_<<' '
+                     <<"capacity: "<<capacity_<<std::endl;
+        }
+};
+
+template <typename... Fields>
+using SoaVector = BasicSoaVector<NewAllocator, Fields...>;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,171 @@
+#ifndef __SPSC_RING_H
+#define __SPSC_RING_H
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <iterator>
+#include <thread>
+
+#include "allocator.h"
+
+// A fixed-size queue for exactly one producer thread and one consumer
+// thread, with no locks and no allocation. head_ and tail_ count every pop
+// and push ever made and only wrap through MASK when they index the slots.
+// Each side keeps a private copy of the other side's index on its own cache
+// line and reloads it only when the ring looks full (or empty), so most
+// operations touch no line the other thread writes.
+//
+// The producer calls the push functions, the consumer the pop functions and
+// front(); size() and empty() may be called from either. As the SEQUENCE of
+// a Queue, push blocks by yielding while the ring is full.
+template<typename T, size_t CAPACITY>
+class SpscRing{
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef T& reference;
+        typedef const value_type& const_reference;
+        typedef size_t size_type;
+        enum{ MASK = CAPACITY - 1 };
+    private:
+        // Consumer side: its index and its copy of tail_.
+        alignas(CACHE_LINE_SIZE) std::atomic<size_type> head_;
+        size_type tail_cache_;
+        // Producer side: its index and its copy of head_.
+        alignas(CACHE_LINE_SIZE) std::atomic<size_type> tail_;
+        size_type head_cache_;
+        alignas(CACHE_LINE_SIZE > alignof(T) ? CACHE_LINE_SIZE : alignof(T)) unsigned char buffer_[CAPACITY * sizeof(T)];
+
+        pointer slot(size_type index){ return reinterpret_cast<pointer>(buffer_) + (index & MASK);}
+
+        // Free slots as the producer sees them, rereading head_ only if
+        // fewer than wanted look free.
+        size_type free_slots(size_type tail, size_type wanted){
+            size_type free_nr = CAPACITY - (tail - head_cache_);
+            if(free_nr < wanted){
+                head_cache_ = head_.load(std::memory_order_acquire);
+                free_nr = CAPACITY - (tail - head_cache_);
+            }
+            return free_nr;
+        }
+
+        // Filled slots as the consumer sees them, rereading tail_ only if
+        // fewer than wanted look filled.
+        size_type filled_slots(size_type head, size_type wanted){
+            size_type filled_nr = tail_cache_ - head;
+            if(filled_nr < wanted){
+                tail_cache_ = tail_.load(std::memory_order_acquire);
+                filled_nr = tail_cache_ - head;
+            }
+            return filled_nr;
+        }
+
+    public:
+        SpscRing():head_(0), tail_cache_(0), tail_(0), head_cache_(0){}
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        ~SpscRing(){
+            size_type head = head_.load(std::memory_order_relaxed), tail = tail_.load(std::memory_order_relaxed);
+            for(; head != tail; ++head) std::destroy_at(slot(head));
+        }
+
+        static constexpr size_type capacity(){ return CAPACITY;}
+
+        // A snapshot; exact only while the other thread is idle.
+        size_type size() const{
+            size_type head = head_.load(std::memory_order_acquire);
+            return tail_.load(std::memory_order_acquire) - head;
+        }
+        bool empty() const{ return size() == 0;}
+
+        // Producer: returns false instead of waiting when the ring is full.
+        template <typename... Args>
+        bool try_emplace( Args&&... args ){
+            size_type tail = tail_.load(std::memory_order_relaxed);
+            if(free_slots(tail, 1) == 0) return false;
+            ::new(static_cast<void*>(slot(tail))) T(std::forward<Args>(args)...);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_push( const_reference value ){ return try_emplace(value);}
+        bool try_push( value_type&& value ){ return try_emplace(std::move(value));}
+
+        // Producer: pushes up to n elements from first and publishes them
+        // with one store. Returns how many fitted.
+        template <typename InputIt>
+        size_type push_n( InputIt first, size_type n ){
+            size_type tail = tail_.load(std::memory_order_relaxed);
+            n = std::min(n, free_slots(tail, n));
+            size_type i = 0;
+            try{
+                for(; i < n; ++i, ++first) ::new(static_cast<void*>(slot(tail + i))) T(*first);
+            }catch(...){
+                while(i > 0) std::destroy_at(slot(tail + --i));
+                throw;
+            }
+            tail_.store(tail + n, std::memory_order_release);
+            return n;
+        }
+
+        // Consumer: moves the front element into value, or returns false if
+        // the ring is empty.
+        bool try_pop( reference value ){
+            size_type head = head_.load(std::memory_order_relaxed);
+            if(filled_slots(head, 1) == 0) return false;
+            pointer p = slot(head);
+            value = std::move(*p);
+            std::destroy_at(p);
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer: moves up to n elements to d_first and frees their slots
+        // with one store. Returns how many were taken.
+        template <typename OutputIt>
+        size_type pop_n( OutputIt d_first, size_type n ){
+            size_type head = head_.load(std::memory_order_relaxed);
+            n = std::min(n, filled_slots(head, n));
+            for(size_type i = 0; i < n; ++i, ++d_first){
+                pointer p = slot(head + i);
+                *d_first = std::move(*p);
+                std::destroy_at(p);
+            }
+            head_.store(head + n, std::memory_order_release);
+            return n;
+        }
+
+        // Queue's SEQUENCE interface. front() and pop_front() expect a
+        // non-empty ring, as seen by the consumer through empty() or size().
+        template <typename... Args>
+        void emplace_back( Args&&... args ){
+            while(!try_emplace(std::forward<Args>(args)...)) std::this_thread::yield();
+        }
+
+        void push_back( const_reference value ){ emplace_back(value);}
+        void push_back( value_type&& value ){ emplace_back(std::move(value));}
+
+        reference front(){ return *slot(head_.load(std::memory_order_relaxed));}
+
+        void pop_front(){
+            size_type head = head_.load(std::memory_order_relaxed);
+            std::destroy_at(slot(head));
+            head_.store(head + 1, std::memory_order_release);
+        }
+
+        void show(){
+            size_type head = head_.load(std::memory_order_acquire), tail = tail_.load(std::memory_order_acquire);
+            for(size_type i = head; i != tail; ++i){
+                std::cout << *slot(i) << ' ';
+            }
+            std::cout << std::endl;
+            std::cout << "size = " << tail - head << std::endl;
+        }
+};
+
+#endif
\ No newline at end of file
@@ -26,6 +26,11 @@ class Stack{
 
     void push( const value_type& value ){ c.push_back(value);}
 
+    void push( value_type&& value ){ c.push_back(std::move(value));}
+
+    template <typename... Args>
+    void emplace( Args&&... args ){ c.emplace_back(std::forward<Args>(args)...);}
+
     void show() { c.show();}
 };
 
@@ -0,0 +1,278 @@
+#ifndef __TASK_SCHEDULER_H
+#define __TASK_SCHEDULER_H
+
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "deque.h"
+#include "work_stealing_deque.h"
+
+// Number of threads running tasks, the thread calling wait() included.
+// 0 means std::thread::hardware_concurrency().
+#ifndef PARALLEL_THREADS
+#define PARALLEL_THREADS 0
+#endif
+
+// Rounds of stealing an idle worker makes before it goes to sleep.
+#ifndef SCHEDULER_IDLE_ROUNDS
+#define SCHEDULER_IDLE_ROUNDS 64
+#endif
+
+class TaskScheduler;
+
+// A set of tasks to wait for together. Tasks may spawn more tasks into the
+// same group. If one throws, tasks of the group that have not started yet
+// are skipped and wait() rethrows the first exception.
+class TaskGroup{
+    friend class TaskScheduler;
+    private:
+        TaskScheduler& scheduler_;
+        std::atomic<size_t> pending_;
+        std::atomic<bool> failed_;
+        std::exception_ptr error_;
+
+        void fail(std::exception_ptr error){
+            if(!failed_.exchange(true)) error_ = error;
+        }
+
+    public:
+        explicit TaskGroup(TaskScheduler& scheduler);
+        TaskGroup();
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        // Waits without rethrowing, so no task outlives the group.
+        ~TaskGroup();
+
+        template <typename FN>
+        void spawn(FN&& fn);
+
+        // Runs tasks, this group's or any other's, until all of this
+        // group's tasks have finished.
+        void wait();
+};
+
+// A pool of workers, each owning a WorkStealingDeque of tasks. A worker
+// pushes the tasks it spawns onto its own deque and pops them newest first,
+// which keeps recursive splits cache-warm; when it runs dry it steals the
+// oldest task, usually the biggest piece of work, from a random victim.
+// Tasks spawned by other threads go through a locked Deque.
+class TaskScheduler{
+    friend class TaskGroup;
+    private:
+        struct task{
+            std::function<void()> fn;
+            TaskGroup* group;
+        };
+
+        struct worker{
+            WorkStealingDeque<task*> tasks;
+        };
+
+        std::vector<std::unique_ptr<worker>> workers_;
+        std::vector<std::thread> threads_;
+        Deque<task*> injected_;
+        std::mutex inject_lock_;
+        // Tasks spawned and not yet taken; idle workers sleep while it is 0.
+        std::atomic<ptrdiff_t> queued_;
+        std::atomic<size_t> sleepers_;
+        std::mutex sleep_lock_;
+        std::condition_variable wake_cv_;
+        bool stop_;
+
+        // Index of the calling thread's worker in this scheduler, or -1.
+        int self() const{
+            const std::pair<const TaskScheduler*, int>& id = current();
+            return id.first == this ? id.second : -1;
+        }
+
+        static std::pair<const TaskScheduler*, int>& current(){
+            static thread_local std::pair<const TaskScheduler*, int> id(nullptr, -1);
+            return id;
+        }
+
+        static std::minstd_rand& victim_rng(){
+            static thread_local std::minstd_rand rng(std::hash<std::thread::id>()(std::this_thread::get_id()));
+            return rng;
+        }
+
+        void push(task* t){
+            int index = self();
+            if(index >= 0){
+                workers_[index]->tasks.push(t);
+            }else{
+                std::lock_guard<std::mutex> guard(inject_lock_);
+                injected_.push_back(t);
+            }
+            // Pairs with the sleeper's increment of sleepers_: either it sees
+            // the new task or we see it asleep.
+            queued_.fetch_add(1);
+            if(sleepers_.load() > 0){
+                std::lock_guard<std::mutex> guard(sleep_lock_);
+                wake_cv_.notify_one();
+            }
+        }
+
+        bool take_injected(task*& t){
+            std::lock_guard<std::mutex> guard(inject_lock_);
+            if(injected_.empty()) return false;
+            t = injected_.front();
+            injected_.pop_front();
+            return true;
+        }
+
+        bool find_task(task*& t){
+            int index = self();
+            bool found = index >= 0 && workers_[index]->tasks.pop(t);
+            if(!found && !workers_.empty()){
+                size_t first = victim_rng()() % workers_.size();
+                for(size_t i = 0; i < workers_.size() && !found; i++){
+                    size_t victim = (first + i) % workers_.size();
+                    if(int(victim) != index) found = workers_[victim]->tasks.steal(t);
+                }
+            }
+            if(!found) found = take_injected(t);
+            if(found) queued_.fetch_sub(1);
+            return found;
+        }
+
+        void run(task* t){
+            TaskGroup* group = t->group;
+            if(!group->failed_.load(std::memory_order_relaxed)){
+                try{
+                    t->fn();
+                }catch(...){
+                    group->fail(std::current_exception());
+                }
+            }
+            delete t;
+            group->pending_.fetch_sub(1, std::memory_order_release);
+        }
+
+        void worker_loop(int index){
+            current() = std::make_pair(this, index);
+            task* t;
+            while(true){
+                bool found = false;
+                for(int round = 0; round < SCHEDULER_IDLE_ROUNDS && !found; round++){
+                    found = find_task(t);
+                    if(!found) std::this_thread::yield();
+                }
+                if(found){
+                    run(t);
+                    continue;
+                }
+                std::unique_lock<std::mutex> guard(sleep_lock_);
+                sleepers_.fetch_add(1);
+                wake_cv_.wait(guard, [this]{ return stop_ || queued_.load() > 0;});
+                sleepers_.fetch_sub(1);
+                if(stop_) return;
+            }
+        }
+
+        void wait(TaskGroup& group){
+            task* t;
+            while(group.pending_.load(std::memory_order_acquire) > 0){
+                if(find_task(t)) run(t);
+                else std::this_thread::yield();
+            }
+        }
+
+        // Spawns the upper half of [first, last) and keeps the lower half,
+        // down to single indices.
+        template <typename FN>
+        void for_range(TaskGroup& group, size_t first, size_t last, FN& fn){
+            while(last - first > 1){
+                size_t mid = first + (last - first) / 2;
+                group.spawn([this, &group, &fn, mid, last]{ for_range(group, mid, last, fn);});
+                last = mid;
+            }
+            fn(first);
+        }
+
+    public:
+        explicit TaskScheduler(size_t thread_nr):queued_(0), sleepers_(0), stop_(false){
+            for(size_t i = 1; i < thread_nr; i++) workers_.emplace_back(new worker);
+            for(size_t i = 0; i < workers_.size(); i++) threads_.emplace_back([this, i]{ worker_loop(int(i));});
+        }
+
+        TaskScheduler(const TaskScheduler&) = delete;
+        TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+        ~TaskScheduler(){
+            {
+                std::lock_guard<std::mutex> guard(sleep_lock_);
+                stop_ = true;
+            }
+            wake_cv_.notify_all();
+            for(auto& t : threads_) t.join();
+        }
+
+        static TaskScheduler& instance(){
+            static TaskScheduler scheduler(PARALLEL_THREADS > 0 ? PARALLEL_THREADS : std::max(1u, std::thread::hardware_concurrency()));
+            return scheduler;
+        }
+
+        size_t thread_count() const{ return workers_.size() + 1;}
+
+        // Calls fn(i) for every i in [0, count) and returns once all calls
+        // have finished, rethrowing the first exception any of them threw.
+        template <typename FN>
+        void parallel_for(size_t count, FN&& fn){
+            if(count == 0) return;
+            if(count == 1 || workers_.empty()){
+                for(size_t i = 0; i < count; i++) fn(i);
+                return;
+            }
+            TaskGroup group(*this);
+            try{
+                for_range(group, 0, count, fn);
+            }catch(...){
+                group.fail(std::current_exception());
+            }
+            group.wait();
+        }
+};
+
+inline TaskGroup::TaskGroup(TaskScheduler& scheduler):scheduler_(scheduler), pending_(0), failed_(false){}
+
+inline TaskGroup::TaskGroup():TaskGroup(TaskScheduler::instance()){}
+
+inline TaskGroup::~TaskGroup(){
+    scheduler_.wait(*this);
+}
+
+template <typename FN>
+void TaskGroup::spawn(FN&& fn){
+    TaskScheduler::task* t = new TaskScheduler::task{std::function<void()>(std::forward<FN>(fn)), this};
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    try{
+        scheduler_.push(t);
+    }catch(...){
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        delete t;
+        throw;
+    }
+}
+
+inline void TaskGroup::wait(){
+    scheduler_.wait(*this);
+    if(failed_.load()){
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        failed_.store(false);
+        std::rethrow_exception(error);
+    }
+}
+
+#endif
\ No newline at end of file
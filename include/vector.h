@@ -2,11 +2,20 @@
 #define __VECTOR_H
 
 #include <memory>
+#include <iterator>
+#include <stdexcept>
 
 #include "allocator.h"
+#include "relocate.h"
+#include "simd.h"
 
-template<typename T, typename ALLOC = NewAllocator<T>>
-class Vector{
+// The element management Vector and SmallVector share. Elements live in
+// [start_, finish_) of a block that ends at end_of_storage_ and grows
+// geometrically. DERIVED owns construction, assignment and swapping, and
+// supplies deallocate_storage() to hand a block back (SmallVector keeps its
+// inline buffer).
+template<typename T, typename ALLOC, typename DERIVED>
+class VectorBase: protected AllocatorHolder<ALLOC>{
     public:
         typedef T value_type;
         typedef T* pointer;
@@ -16,36 +25,131 @@ class Vector{
         typedef size_t size_type;
         typedef pointer iterator;
         typedef const_pointer const_iterator;
-        typedef Vector<T, ALLOC> Self;
-    private:
+        typedef ALLOC allocator_type;
+        typedef AllocatorTraits<ALLOC> alloc_traits;
+    protected:
+        typedef AllocatorHolder<ALLOC> holder;
+
         pointer start_;
         pointer finish_;
         pointer end_of_storage_;
 
-    public:
-        Vector():start_(nullptr), finish_(nullptr), end_of_storage_(nullptr) {}
-        Vector(size_type n, const_reference value = value_type()){
-            start_ = ALLOC::allocate(n);
-            finish_ = end_of_storage_ = start_ + n;
-            std::uninitialized_fill_n(start_, n, value);
+        VectorBase():start_(nullptr), finish_(nullptr), end_of_storage_(nullptr){}
+        explicit VectorBase(const ALLOC& alloc):holder(alloc), start_(nullptr), finish_(nullptr), end_of_storage_(nullptr){}
+        explicit VectorBase(ALLOC&& alloc):holder(std::move(alloc)), start_(nullptr), finish_(nullptr), end_of_storage_(nullptr){}
+
+        using holder::alloc;
+
+        void deallocate_storage(){ static_cast<DERIVED*>(this)->deallocate_storage();}
+
+        // Moves the elements into new_cap slots of fresh storage, leaving
+        // count uninitialised slots at pos that construct(gap) fills first.
+        // Relocatable types are moved with memcpy or a nothrow move. Others
+        // are copied, or moved if they cannot be copied, and if anything
+        // throws the vector keeps its old storage.
+        template <typename CONSTRUCT>
+        iterator reallocate(size_type new_cap, iterator pos, size_type count, CONSTRUCT construct){
+            size_type new_size = size() + count;
+            pointer new_start = alloc().allocate(new_cap);
+            pointer gap = new_start + (pos - start_);
+            try{
+                construct(gap);
+            }catch(...){
+                alloc().deallocate(new_start, new_cap);
+                throw;
+            }
+            if constexpr(is_nothrow_relocatable<T>::value){
+                uninitialized_relocate(start_, pos, new_start);
+                uninitialized_relocate(pos, finish_, gap + count);
+            }else{
+                try{
+                    uninitialized_move_if_noexcept(start_, pos, new_start);
+                    try{
+                        uninitialized_move_if_noexcept(pos, finish_, gap + count);
+                    }catch(...){
+                        std::destroy(new_start, gap);
+                        throw;
+                    }
+                }catch(...){
+                    std::destroy(gap, gap + count);
+                    alloc().deallocate(new_start, new_cap);
+                    throw;
+                }
+                std::destroy(start_, finish_);
+            }
+            deallocate_storage();
+            start_ = new_start;
+            finish_ = new_start + new_size;
+            end_of_storage_ = new_start + new_cap;
+            return gap;
         }
-        template< class InputIt >
-        Vector( InputIt first, InputIt last){
-            size_type n = std::distance(first, last);
-            start_ = ALLOC::allocate(n);
-            finish_ = end_of_storage_ = start_ + n;
-            std::uninitialized_copy(first, last, start_);
-        }
-        Vector(const Vector& other):Vector(other.begin(), other.end()){}
-        Vector(Vector&& other):start_(other.start_), finish_(other.finish_), end_of_storage_(other.end_of_storage_){
-            other.start_ = nullptr;
-            other.finish_ = nullptr;
-            other.end_of_storage_ = nullptr;
-        }                  
-        ~Vector(){
-            std::destroy(start_, finish_);
-            ALLOC::deallocate(start_, size());
+
+        size_type grow_capacity(size_type count) const{
+            return std::max(2 * capacity(), size() + count);
         }
+
+        // Inserts the count elements starting at first before pos. The source
+        // must not be part of this vector.
+        template <typename ForwardIt>
+        iterator insert_n(iterator pos, size_type count, ForwardIt first){
+            if(count == 0) return pos;
+            if(count > capacity() - size()){
+                return reallocate(grow_capacity(count), pos, count, [&](pointer gap){ std::uninitialized_copy_n(first, count, gap); });
+            }
+            size_type tail = end() - pos;
+            if constexpr(is_trivially_relocatable<T>::value){
+                // Open the gap with one memmove and build the new elements in it.
+                std::memmove(static_cast<void*>(pos + count), static_cast<const void*>(pos), tail * sizeof(T));
+                try{
+                    std::uninitialized_copy_n(first, count, pos);
+                }catch(...){
+                    std::memmove(static_cast<void*>(pos), static_cast<const void*>(pos + count), tail * sizeof(T));
+                    throw;
+                }
+            }else if(tail > count){
+                std::uninitialized_move(end() - count, end(), end());
+                std::move_backward(pos, end() - count, end());
+                std::copy_n(first, count, pos);
+            }else{
+                ForwardIt mid = std::next(first, tail);
+                std::uninitialized_copy_n(mid, count - tail, end());
+                std::uninitialized_move(pos, end(), pos + count);
+                std::copy_n(first, tail, pos);
+            }
+            finish_ += count;
+            return pos;
+        }
+
+        // Growth path of emplace and emplace_back, kept out of line so the
+        // append fast path stays small enough to inline.
+        template <typename... Args>
+        __attribute__((noinline, cold)) iterator realloc_emplace(iterator pos, Args&&... args){
+            return reallocate(grow_capacity(1), pos, 1, [&](pointer gap){ ::new(static_cast<void*>(gap)) T(std::forward<Args>(args)...); });
+        }
+
+        // Fills an empty vector from a range, for the range constructors.
+        // Forward ranges are measured and allocated once; input ranges are
+        // appended. If anything throws, the storage is released.
+        template <typename InputIt>
+        void init_range( InputIt first, InputIt last ){
+            typedef typename std::iterator_traits<InputIt>::iterator_category category;
+            try{
+                if constexpr(std::is_base_of<std::forward_iterator_tag, category>::value){
+                    size_type n = std::distance(first, last);
+                    reserve(n);
+                    finish_ = std::uninitialized_copy(first, last, start_);
+                }else{
+                    for(; first != last; ++first) emplace_back(*first);
+                }
+            }catch(...){
+                clear();
+                deallocate_storage();
+                throw;
+            }
+        }
+
+    public:
+        allocator_type get_allocator() const { return alloc();}
         iterator begin() { return start_; }
         iterator end() { return finish_; }
         const_iterator begin() const { return start_; }
@@ -55,7 +159,10 @@ class Vector{
         bool empty() const { return begin() == end(); }
         reference front() { return (*this)[0];}
         reference back() { return (*this)[size() - 1]; }
+        const_reference front() const { return (*this)[0];}
+        const_reference back() const { return (*this)[size() - 1]; }
         pointer data() { return start_;}
+        const_pointer data() const { return start_;}
 
         void clear(){
             std::destroy(begin(), end());
@@ -63,86 +170,136 @@ class Vector{
         }
 
         reference operator[]( size_type pos ){ return *(begin() + pos);}
-        Vector& operator=(const Vector& other){
-            if(this == &other) return *this;
-            if(other.size() > capacity()){
-                Vector<value_type> tmp = other;
-                swap(tmp);
-            }else if(other.size() > size()){
-                std::copy(other.begin(), other.begin() + size(), start_);
-                finish_ = std::uninitialized_copy(other.begin() + size(), other.end(), finish_);
+        const_reference operator[]( size_type pos ) const{ return *(begin() + pos);}
+
+        void reserve( size_type new_cap ){
+            if(new_cap > capacity()){
+                reallocate(new_cap, end(), 0, [](pointer){});
+            }
+        }
+
+        iterator insert( iterator pos, const T& value ){
+            return emplace(pos, value);
+        }
+
+        iterator insert( iterator pos, T&& value ){
+            return emplace(pos, std::move(value));
+        }
+
+        // Forward ranges are measured once, so there is at most one
+        // reallocation and the tail moves once; input ranges are appended
+        // with geometric growth and rotated into place.
+        template< class InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category >
+        iterator insert( iterator pos, InputIt first, InputIt last ){
+            typedef typename std::iterator_traits<InputIt>::iterator_category category;
+            if constexpr(std::is_base_of<std::forward_iterator_tag, category>::value){
+                return insert_n(pos, std::distance(first, last), first);
             }else{
-                pointer new_finish =  std::copy(other.begin(), other.end(), start_);
-                std::destroy(new_finish, end());
-                finish_ = new_finish;
+                size_type offset = pos - start_, old_size = size();
+                for(; first != last; ++first) emplace_back(*first);
+                std::rotate(start_ + offset, start_ + old_size, finish_);
+                return start_ + offset;
             }
-            return *this;
         }
-        Vector& operator=(Vector&& other){
-            if(this == &other) return *this;
-            destroy(begin(), end());
-            ALLOC::deallocate(start_, capacity());
-            start_ = other.start_;
-            finish_ = other.finish_;
-            end_of_storage_ = other.end_of_storage_;
-            other.start_ = other.finish_ = other.end_of_storage_ = nullptr;
-            return *this;
+
+        template <typename Range>
+        void append_range( Range&& range ){
+            insert(end(), std::begin(range), std::end(range));
         }
 
-        void swap( Vector& other ){
-            std::swap(start_, other.start_);
-            std::swap(finish_, other.finish_);
-            std::swap(end_of_storage_, other.end_of_storage_);
+        // value may be an element of this vector.
+        void assign( size_type count, const T& value ){
+            if(count > capacity()){
+                value_type tmp(value);
+                clear();
+                reallocate(count, begin(), count, [&](pointer gap){ std::uninitialized_fill_n(gap, count, tmp); });
+            }else if(count > size()){
+                std::fill(begin(), end(), value);
+                finish_ = std::uninitialized_fill_n(finish_, count - size(), value);
+            }else{
+                std::fill_n(begin(), count, value);
+                erase(begin() + count, end());
+            }
         }
 
-        void reserve( size_type new_cap ){
-            if(new_cap > capacity()){
-                pointer new_start = ALLOC::allocate(new_cap);
-                pointer new_finish = std::uninitialized_copy(start_, finish_, new_start);
-                std::destroy(begin(), end());
-                ALLOC::deallocate(start_, capacity());
-                start_ = new_start;
-                finish_ = new_finish;
-                end_of_storage_ = start_ + new_cap;
+        template< class InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category >
+        void assign( InputIt first, InputIt last ){
+            typedef typename std::iterator_traits<InputIt>::iterator_category category;
+            if constexpr(std::is_base_of<std::forward_iterator_tag, category>::value){
+                size_type count = std::distance(first, last);
+                if(count > capacity()){
+                    clear();
+                    reallocate(count, begin(), count, [&](pointer gap){ std::uninitialized_copy_n(first, count, gap); });
+                }else if(count > size()){
+                    InputIt mid = std::next(first, size());
+                    std::copy(first, mid, begin());
+                    finish_ = std::uninitialized_copy(mid, last, finish_);
+                }else{
+                    erase(std::copy(first, last, begin()), end());
+                }
+            }else{
+                iterator it = begin();
+                for(; first != last && it != end(); ++first, ++it) *it = *first;
+                if(it != end()) erase(it, end());
+                for(; first != last; ++first) emplace_back(*first);
             }
         }
 
-        iterator insert( iterator pos, const T& value ){
-            return insert(pos, 1, value );
+        template <typename... Args>
+        iterator emplace( iterator pos, Args&&... args ){
+            if(pos == end()){
+                emplace_back(std::forward<Args>(args)...);
+                return end() - 1;
+            }
+            if(finish_ == end_of_storage_) return realloc_emplace(pos, std::forward<Args>(args)...);
+            // Build the value first: args may refer to elements about to move.
+            value_type tmp(std::forward<Args>(args)...);
+            ::new(static_cast<void*>(finish_)) T(std::move(*(finish_ - 1)));
+            ++finish_;
+            std::move_backward(pos, finish_ - 2, finish_ - 1);
+            *pos = std::move(tmp);
+            return pos;
+        }
+
+        template <typename... Args>
+        reference emplace_back( Args&&... args ){
+            if(finish_ != end_of_storage_){
+                ::new(static_cast<void*>(finish_)) T(std::forward<Args>(args)...);
+                ++finish_;
+                return *(finish_ - 1);
+            }
+            return *realloc_emplace(end(), std::forward<Args>(args)...);
         }
 
+        // value may be an element of this vector: the growth path builds the
+        // copies before the old storage goes, the others copy it aside.
         iterator insert( iterator pos, size_type count, const T& value ){
             if(count == 0) return pos;
             if(count + size() > capacity()){
-                size_type new_cap = std::max(2 * capacity(), count + size());
-                pointer new_start = ALLOC::allocate(new_cap);
-                pointer new_finish = std::uninitialized_move(begin(), pos, new_start);
-                iterator ret = new_finish;
-                new_finish = std::uninitialized_fill_n(new_finish, count, value);
-                new_finish = std::uninitialized_move(pos, end(), new_finish);
-                std::destroy(begin(), end());
-                ALLOC::deallocate(start_, capacity());
-                start_ = new_start;
-                finish_ = new_finish;
-                end_of_storage_ = start_ + new_cap;
-                return ret;
+                return reallocate(grow_capacity(count), pos, count, [&](pointer gap){ std::uninitialized_fill_n(gap, count, value); });
             }else if(pos + count < end()){
+                value_type tmp(value);
                 std::uninitialized_move(end() - count, end(), end());
                 std::move_backward(pos, end() - count, end());
-                std::fill_n(pos, count, value);
+                std::fill_n(pos, count, tmp);
                 finish_ += count;
                 return pos;
             }else{
+                value_type tmp(value);
                 std::uninitialized_move(pos, end(), pos + count);
-                std::uninitialized_fill(end(), pos + count, value);
-                std::fill(pos, end(), value);
+                std::uninitialized_fill(end(), pos + count, tmp);
+                std::fill(pos, end(), tmp);
                 finish_ += count;
                 return pos;
             }
         }
 
         void push_back( const T& value ){
-            insert(end(), value);
+            emplace_back(value);
+        }
+
+        void push_back( T&& value ){
+            emplace_back(std::move(value));
         }
 
         iterator erase( iterator first, iterator last ){
@@ -161,15 +318,162 @@ class Vector{
         }
 
         void resize( size_type count, const value_type& value ){
-            reserve(count);
             if(count > size()){
                 insert(end(), count - size(), value);
+            }else{
+                erase(begin() + count, end());
             }
         }
 
         void resize( size_type count ){
             resize(count, value_type());
         }
+};
+
+template<typename T, typename ALLOC = NewAllocator<T>>
+class Vector: public VectorBase<T, ALLOC, Vector<T, ALLOC>>{
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef T& reference;
+        typedef const T* const_pointer;
+        typedef const value_type& const_reference;
+        typedef size_t size_type;
+        typedef pointer iterator;
+        typedef const_pointer const_iterator;
+        typedef Vector<T, ALLOC> Self;
+        typedef ALLOC allocator_type;
+        typedef AllocatorTraits<ALLOC> alloc_traits;
+    private:
+        typedef VectorBase<T, ALLOC, Vector> base;
+        friend base;
+
+        using base::start_;
+        using base::finish_;
+        using base::end_of_storage_;
+        using base::alloc;
+
+        void deallocate_storage(){
+            if(start_ != nullptr) alloc().deallocate(start_, capacity());
+        }
+
+        void steal(Vector& other){
+            start_ = other.start_;
+            finish_ = other.finish_;
+            end_of_storage_ = other.end_of_storage_;
+            other.start_ = other.finish_ = other.end_of_storage_ = nullptr;
+        }
+
+        void swap_storage( Vector& other ){
+            std::swap(start_, other.start_);
+            std::swap(finish_, other.finish_);
+            std::swap(end_of_storage_, other.end_of_storage_);
+        }
+
+    public:
+        using base::begin;
+        using base::end;
+        using base::size;
+        using base::capacity;
+        using base::empty;
+        using base::clear;
+
+        Vector() = default;
+        explicit Vector(const ALLOC& alloc):base(alloc){}
+        Vector(size_type n, const_reference value = value_type(), const ALLOC& alloc = ALLOC()):base(alloc){
+            start_ = this->alloc().allocate(n);
+            finish_ = end_of_storage_ = start_ + n;
+            std::uninitialized_fill_n(start_, n, value);
+        }
+        template< class InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category >
+        Vector( InputIt first, InputIt last, const ALLOC& alloc = ALLOC()):base(alloc){
+            this->init_range(first, last);
+        }
+        Vector(const Vector& other):Vector(other.begin(), other.end(), alloc_traits::select_on_container_copy_construction(other.alloc())){}
+        Vector(const Vector& other, const ALLOC& alloc):Vector(other.begin(), other.end(), alloc){}
+        Vector(Vector&& other):base(std::move(other.alloc())){
+            steal(other);
+        }
+        Vector(Vector&& other, const ALLOC& alloc):base(alloc){
+            if(alloc_traits::equal(this->alloc(), other.alloc())){
+                steal(other);
+            }else{
+                size_type n = other.size();
+                start_ = this->alloc().allocate(n);
+                finish_ = end_of_storage_ = start_ + n;
+                std::uninitialized_move(other.begin(), other.end(), start_);
+            }
+        }
+        ~Vector(){
+            std::destroy(start_, finish_);
+            deallocate_storage();
+        }
+
+        Vector& operator=(const Vector& other){
+            if(this == &other) return *this;
+            if(alloc_traits::propagate_on_container_copy_assignment::value && !alloc_traits::equal(alloc(), other.alloc())){
+                clear();
+                deallocate_storage();
+                start_ = finish_ = end_of_storage_ = nullptr;
+            }
+            alloc_traits::on_copy_assign(alloc(), other.alloc());
+            if(other.size() > capacity()){
+                Vector tmp(other, alloc());
+                swap_storage(tmp);
+            }else if(other.size() > size()){
+                std::copy(other.begin(), other.begin() + size(), start_);
+                finish_ = std::uninitialized_copy(other.begin() + size(), other.end(), finish_);
+            }else{
+                pointer new_finish =  std::copy(other.begin(), other.end(), start_);
+                std::destroy(new_finish, end());
+                finish_ = new_finish;
+            }
+            return *this;
+        }
+        Vector& operator=(Vector&& other){
+            if(this == &other) return *this;
+            if(alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::equal(alloc(), other.alloc())){
+                std::destroy(begin(), end());
+                deallocate_storage();
+                alloc_traits::on_move_assign(alloc(), other.alloc());
+                steal(other);
+            }else{
+                Vector tmp(std::move(other), alloc());
+                swap_storage(tmp);
+            }
+            return *this;
+        }
+
+        void swap( Vector& other ){
+            swap_storage(other);
+            alloc_traits::on_swap(alloc(), other.alloc());
+        }
+
+        // Vectorised bulk operations for arithmetic element types; see simd.h.
+        // min and max throw std::length_error on an empty vector, dot and
+        // add when other has a different size.
+        iterator find( const T& value ){ return start_ + simd_find(start_, size(), value);}
+        size_type count( const T& value ) const{ return simd_count(start_, size(), value);}
+        value_type min() const{
+            if(empty()) throw std::length_error("Vector::min: empty vector");
+            return simd_min(start_, size());
+        }
+        value_type max() const{
+            if(empty()) throw std::length_error("Vector::max: empty vector");
+            return simd_max(start_, size());
+        }
+        value_type sum() const{ return simd_sum(start_, size());}
+        value_type dot( const Vector& other ) const{
+            if(size() != other.size()) throw std::length_error("Vector::dot: sizes differ");
+            return simd_dot(start_, other.start_, size());
+        }
+        void fill( const T& value ){ simd_fill(start_, size(), value);}
+        bool equal( const Vector& other ) const{ return size() == other.size() && simd_equal(start_, other.start_, size());}
+        void add( const Vector& other ){
+            if(size() != other.size()) throw std::length_error("Vector::add: sizes differ");
+            simd_add(start_, other.start_, size());
+        }
+        void scale( const T& factor ){ simd_scale(start_, size(), factor);}
 
         void show() const{
             for(auto &x : *this){
@@ -0,0 +1,121 @@
+#ifndef __WORK_STEALING_DEQUE_H
+#define __WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "allocator.h"
+
+// Initial slot count of a WorkStealingDeque; it doubles whenever it fills.
+#ifndef WORK_STEALING_INITIAL_CAPACITY
+#define WORK_STEALING_INITIAL_CAPACITY 256
+#endif
+
+// The Chase-Lev deque, with the memory orders of Le et al., "Correct and
+// Efficient Work-Stealing for Weak Memory Models". One owner thread pushes
+// and pops at the bottom without atomic read-modify-writes except when
+// racing a thief for the last element; any number of thieves take from the
+// top with a CAS. Elements are small trivially copyable values such as task
+// pointers. The ring grows but never shrinks; rings it outgrew are freed
+// with the deque, since a thief may still be reading one.
+template<typename T>
+class WorkStealingDeque{
+    static_assert(std::is_trivially_copyable<T>::value, "elements are copied through atomics");
+    public:
+        typedef T value_type;
+        typedef size_t size_type;
+    private:
+        struct ring{
+            ptrdiff_t mask;
+            std::atomic<T>* slots;
+
+            explicit ring(ptrdiff_t cap):mask(cap - 1), slots(new std::atomic<T>[cap]){}
+            ~ring(){ delete[] slots;}
+
+            ptrdiff_t capacity() const{ return mask + 1;}
+            T get(ptrdiff_t i) const{ return slots[i & mask].load(std::memory_order_relaxed);}
+            void put(ptrdiff_t i, T value){ slots[i & mask].store(value, std::memory_order_relaxed);}
+        };
+
+        alignas(CACHE_LINE_SIZE) std::atomic<ptrdiff_t> top_;
+        alignas(CACHE_LINE_SIZE) std::atomic<ptrdiff_t> bottom_;
+        std::atomic<ring*> ring_;
+        std::vector<ring*> retired_;
+
+        ring* grow(ring* old, ptrdiff_t top, ptrdiff_t bottom){
+            ring* bigger = new ring(old->capacity() * 2);
+            for(ptrdiff_t i = top; i != bottom; ++i) bigger->put(i, old->get(i));
+            retired_.push_back(old);
+            ring_.store(bigger, std::memory_order_release);
+            return bigger;
+        }
+
+    public:
+        WorkStealingDeque():top_(0), bottom_(0), ring_(new ring(WORK_STEALING_INITIAL_CAPACITY)){
+            static_assert((WORK_STEALING_INITIAL_CAPACITY & (WORK_STEALING_INITIAL_CAPACITY - 1)) == 0, "WORK_STEALING_INITIAL_CAPACITY must be a power of two");
+        }
+
+        WorkStealingDeque(const WorkStealingDeque&) = delete;
+        WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+        ~WorkStealingDeque(){
+            delete ring_.load(std::memory_order_relaxed);
+            for(ring* r : retired_) delete r;
+        }
+
+        // A snapshot; either end may move while it is taken.
+        size_type size() const{
+            ptrdiff_t bottom = bottom_.load(std::memory_order_relaxed);
+            ptrdiff_t top = top_.load(std::memory_order_relaxed);
+            return bottom > top ? size_type(bottom - top) : 0;
+        }
+        bool empty() const{ return size() == 0;}
+
+        // Owner only.
+        void push(T value){
+            ptrdiff_t bottom = bottom_.load(std::memory_order_relaxed);
+            ptrdiff_t top = top_.load(std::memory_order_acquire);
+            ring* r = ring_.load(std::memory_order_relaxed);
+            if(bottom - top > r->mask) r = grow(r, top, bottom);
+            r->put(bottom, value);
+            // The paper's release fence and relaxed store, as one release store.
+            bottom_.store(bottom + 1, std::memory_order_release);
+        }
+
+        // Owner only: takes the most recently pushed element.
+        bool pop(T& value){
+            ptrdiff_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+            ring* r = ring_.load(std::memory_order_relaxed);
+            bottom_.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            ptrdiff_t top = top_.load(std::memory_order_relaxed);
+            if(top > bottom){
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
+                return false;
+            }
+            value = r->get(bottom);
+            if(top == bottom){
+                // The last element: whoever moves top_ past it wins.
+                bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
+                return won;
+            }
+            return true;
+        }
+
+        // Any thread: takes the oldest element. Fails when the deque is
+        // empty or another thread took that element first.
+        bool steal(T& value){
+            ptrdiff_t top = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            ptrdiff_t bottom = bottom_.load(std::memory_order_acquire);
+            if(top >= bottom) return false;
+            ring* r = ring_.load(std::memory_order_acquire);
+            value = r->get(top);
+            return top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        }
+};
+
+#endif
\ No newline at end of file
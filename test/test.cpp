@@ -1,3 +1,8 @@
+// The pool tests read the allocator statistics.
+#define POOL_ALLOCATOR_STATS 1
+// Run the parallel algorithms on several threads even on one core.
+#define PARALLEL_THREADS 4
+
 #include <iostream>
 
 #include "../include/list.h"
@@ -5,6 +10,21 @@
 #include "../include/deque.h"
 #include "../include/queue.h"
 #include "../include/stack.h"
+#include "../include/arena.h"
+#include "../include/small_vector.h"
+#include "../include/mapped_vector.h"
+#include "../include/parallel.h"
+#include "../include/soa_vector.h"
+#include "../include/spsc_ring.h"
+#include "../include/mpmc_queue.h"
+#include "../include/priority_queue.h"
+#include "../include/ring_buffer.h"
+
+#include <deque>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <thread>
 
 
 using namespace std;
@@ -12,7 +32,1785 @@ using namespace std;
 #include "../include/rb_tree.h"
 #include "../include/map.h"
 
+static int failures = 0;
+
+#define CHECK(cond) do{ \
+    if(!(cond)){ \
+        cout << __FILE__ << ':' << __LINE__ << ": CHECK failed: " #cond << endl; \
+        failures++; \
+    } \
+}while(0)
+
+// Calls fn and reports whether it threw an EXCEPTION.
+template <typename EXCEPTION, typename FN>
+bool throws(FN fn){
+    try{
+        fn();
+    }catch(const EXCEPTION&){
+        return true;
+    }
+    return false;
+}
+
+// Threads allocate from their own caches, check no object was handed out
+// twice, and the main thread frees everything across threads.
+void test_pool_threads(){
+    struct Obj{ long owner; long index; long pad;};
+    typedef PollAllocator<Obj> Alloc;
+    const int thread_nr = 4, obj_nr = 2000;
+    Vector<Obj*> objs[thread_nr];
+    std::thread threads[thread_nr];
+    for(int t = 0; t < thread_nr; t++){
+        threads[t] = std::thread([&objs, t]{
+            for(int round = 0; round < 3; round++){
+                for(int i = 0; i < obj_nr; i++){
+                    Obj* p = Alloc::allocate(1);
+                    p->owner = t;
+                    p->index = i;
+                    objs[t].push_back(p);
+                }
+                // Free every other object so the cache and central lists mix.
+                for(int i = 0; i < obj_nr; i += 2) Alloc::deallocate(objs[t][objs[t].size() - obj_nr + i], 1);
+                Vector<Obj*> kept;
+                for(int i = 1; i < obj_nr; i += 2) kept.push_back(objs[t][objs[t].size() - obj_nr + i]);
+                objs[t].erase(objs[t].end() - obj_nr, objs[t].end());
+                for(Obj* p : kept) objs[t].push_back(p);
+            }
+        });
+    }
+    for(std::thread& th : threads) th.join();
+    for(int t = 0; t < thread_nr; t++){
+        CHECK(objs[t].size() == size_t(3 * obj_nr / 2));
+        bool intact = true;
+        for(size_t i = 0; i < objs[t].size(); i++){
+            intact = intact && objs[t][i]->owner == t && objs[t][i]->index == long(i % (obj_nr / 2)) * 2 + 1;
+        }
+        CHECK(intact);
+        for(Obj* p : objs[t]) Alloc::deallocate(p, 1);
+    }
+    Obj* p = Alloc::allocate(1);
+    p->owner = -1;
+    CHECK(p->owner == -1);
+    Alloc::deallocate(p, 1);
+
+    // held is built before the thread's cache, so it is destroyed after it;
+    // its frees and allocations go straight to the central pool and still
+    // count.
+    struct ExitFree{
+        Obj* objs[4] = {};
+        ~ExitFree(){
+            for(Obj* p : objs) Alloc::deallocate(p, 1);
+            Alloc::deallocate(Alloc::allocate(1), 1);
+        }
+    };
+    typedef PoolAllocatorBase::pool_stats pool_stats;
+    const size_t index = sizeof(Obj) / 8 - 1;
+    pool_stats before = PoolAllocatorBase::stats();
+    std::thread([]{
+        thread_local ExitFree held;
+        for(Obj*& p : held.objs) p = Alloc::allocate(1);
+    }).join();
+    pool_stats after = PoolAllocatorBase::stats();
+    CHECK(after.classes[index].allocations - before.classes[index].allocations == 5);
+    CHECK(after.classes[index].frees - before.classes[index].frees == 5);
+}
+
+void test_pool_stats(){
+    struct Obj40{ char bytes[40];};
+    struct Big{ char bytes[300];};
+    typedef PoolAllocatorBase::pool_stats pool_stats;
+    const size_t index = 40 / 8 - 1;
+    pool_stats before = PoolAllocatorBase::stats();
+    Obj40* objs[10];
+    for(Obj40*& p : objs) p = PollAllocator<Obj40>::allocate(1);
+    for(int i = 0; i < 3; i++) PollAllocator<Obj40>::deallocate(objs[i], 1);
+    pool_stats mid = PoolAllocatorBase::stats();
+    CHECK(mid.classes[index].obj_size == 40);
+    CHECK(mid.classes[index].allocations - before.classes[index].allocations == 10);
+    CHECK(mid.classes[index].frees - before.classes[index].frees == 3);
+    CHECK(mid.classes[index].refills > before.classes[index].refills || before.classes[index].free_bytes >= 10 * 40);
+    CHECK(mid.heap_size >= 10 * 40);
+
+    Big* big = PollAllocator<Big>::allocate(1);
+    pool_stats large = PoolAllocatorBase::stats();
+    CHECK(large.large_allocations - before.large_allocations == 1);
+    CHECK(large.large_bytes - before.large_bytes == sizeof(Big));
+    PollAllocator<Big>::deallocate(big, 1);
+    CHECK(PoolAllocatorBase::stats().large_frees - before.large_frees == 1);
+
+    for(int i = 3; i < 10; i++) PollAllocator<Obj40>::deallocate(objs[i], 1);
+    pool_stats after = PoolAllocatorBase::stats();
+    CHECK(after.classes[index].allocations - after.classes[index].frees ==
+          before.classes[index].allocations - before.classes[index].frees);
+}
+
+// NewChunkSource that counts the bytes the pool holds.
+struct CountingChunkSource{
+    static long live_bytes;
+    static void* allocate(size_t bytes_nr){ live_bytes += bytes_nr; return NewChunkSource::allocate(bytes_nr);}
+    static void deallocate(void* p, size_t bytes_nr){ live_bytes -= bytes_nr; NewChunkSource::deallocate(p, bytes_nr);}
+};
+long CountingChunkSource::live_bytes = 0;
+
+void test_chunk_source(){
+    char* a = static_cast<char*>(MmapChunkSource::allocate(1000));
+    char* b = static_cast<char*>(MmapChunkSource::allocate(5000));
+    CHECK(a != nullptr && b != nullptr);
+    CHECK(reinterpret_cast<uintptr_t>(a) % MmapChunkSource::CHUNK_ALIGN == 0);
+    CHECK(reinterpret_cast<uintptr_t>(b) % MmapChunkSource::CHUNK_ALIGN == 0);
+    CHECK(b >= a + 1000 || a >= b + 5000);
+    std::memset(a, 1, 1000);
+    std::memset(b, 2, 5000);
+    CHECK(a[999] == 1 && b[0] == 2);
+    MmapChunkSource::deallocate(a, 1000);
+    CHECK(b[4999] == 2);
+    MmapChunkSource::deallocate(b, 5000);
+
+    // Freed chunks are reused: at the tail, inside the region, and in an
+    // older region before a new one is mapped.
+    {
+        typedef MmapChunkSource Source;
+        char* a = static_cast<char*>(Source::allocate(1000));
+        char* b = static_cast<char*>(Source::allocate(5000));
+        Source::deallocate(b, 5000);
+        CHECK(Source::allocate(5000) == b);
+        char* d = static_cast<char*>(Source::allocate(3000));
+        Source::deallocate(b, 5000);
+        CHECK(Source::allocate(2000) == b && Source::allocate(3000) == b + 2048);
+        Source::deallocate(a, 1000);
+        char* big = static_cast<char*>(Source::allocate(Source::REGION_SIZE - Source::CHUNK_ALIGN));
+        CHECK(big != nullptr && Source::allocate(1000) == a);
+        big[0] = a[0] = 1;
+        Source::deallocate(big, Source::REGION_SIZE - Source::CHUNK_ALIGN);
+        Source::deallocate(a, 1000);
+        Source::deallocate(b, 2000);
+        Source::deallocate(b + 2048, 3000);
+        Source::deallocate(d, 3000);
+    }
+
+    struct Obj{ long x[3];};
+    PoolAllocatorBase::reset();
+    PoolAllocatorBase::use_chunk_source<CountingChunkSource>();
+    Obj* p = PollAllocator<Obj>::allocate(1);
+    p->x[2] = 5;
+    CHECK(CountingChunkSource::live_bytes > 0 && long(PoolAllocatorBase::stats().heap_size) == CountingChunkSource::live_bytes);
+    PollAllocator<Obj>::deallocate(p, 1);
+    PoolAllocatorBase::reset();
+    CHECK(CountingChunkSource::live_bytes == 0);
+
+    PoolAllocatorBase::use_chunk_source<MmapChunkSource>();
+    Vector<Obj*> objs;
+    for(int i = 0; i < 10000; i++){
+        objs.push_back(PollAllocator<Obj>::allocate(1));
+        objs.back()->x[0] = i;
+    }
+    bool intact = true;
+    for(int i = 0; i < 10000; i++) intact = intact && objs[i]->x[0] == i;
+    CHECK(intact);
+    for(Obj* o : objs) PollAllocator<Obj>::deallocate(o, 1);
+    PoolAllocatorBase::reset();
+    PoolAllocatorBase::use_chunk_source<NewChunkSource>();
+}
+
+void test_pool_trim(){
+    struct Obj{ long x[4];};
+    PoolAllocatorBase::reset();
+    PoolAllocatorBase::use_chunk_source<CountingChunkSource>();
+    CHECK(PoolAllocatorBase::trim() == 0);
+    Vector<Obj*> objs;
+    for(int i = 0; i < 5000; i++) objs.push_back(PollAllocator<Obj>::allocate(1));
+    long held = CountingChunkSource::live_bytes;
+    CHECK(held > 0);
+    // One live object keeps its chunk; everything else can go back.
+    for(size_t i = 1; i < objs.size(); i++) PollAllocator<Obj>::deallocate(objs[i], 1);
+    size_t released = PoolAllocatorBase::trim();
+    CHECK(released > 0 && CountingChunkSource::live_bytes == held - long(released));
+    CHECK(CountingChunkSource::live_bytes > 0);
+    objs[0]->x[3] = 9;
+    CHECK(objs[0]->x[3] == 9);
+    PollAllocator<Obj>::deallocate(objs[0], 1);
+    PoolAllocatorBase::trim();
+    CHECK(CountingChunkSource::live_bytes == 0 && PoolAllocatorBase::stats().heap_size == 0);
+
+    for(int i = 0; i < 100; i++) PollAllocator<Obj>::allocate(1);
+    CHECK(CountingChunkSource::live_bytes > 0);
+    PoolAllocatorBase::reset();
+    CHECK(CountingChunkSource::live_bytes == 0 && PoolAllocatorBase::stats().heap_size == 0);
+    Obj* p = PollAllocator<Obj>::allocate(1);
+    p->x[0] = 1;
+    PollAllocator<Obj>::deallocate(p, 1);
+    PoolAllocatorBase::reset();
+    PoolAllocatorBase::use_chunk_source<NewChunkSource>();
+}
+
+// A NewAllocator with an identity that follows the container on move
+// assignment.
+template <typename T>
+struct TaggedAllocator: NewAllocator<T>{
+    typedef std::true_type propagate_on_container_move_assignment;
+    int id;
+    explicit TaggedAllocator(int tag = 0):id(tag){}
+    template <typename U>
+    TaggedAllocator(const TaggedAllocator<U>& other):id(other.id){}
+    bool operator==(const TaggedAllocator& other) const{ return id == other.id;}
+};
+
+template <typename T>
+bool in_buffer(const T* p, const char* buffer, size_t size){
+    const char* c = reinterpret_cast<const char*>(p);
+    return c >= buffer && c < buffer + size;
+}
+
+void test_stateful_allocators(){
+    alignas(64) static char buf1[1 << 16], buf2[1 << 16];
+    MonotonicArena arena1(buf1, sizeof(buf1)), arena2(buf2, sizeof(buf2));
+
+    typedef Vector<int, ArenaAllocator<int>> ArenaVector;
+    ArenaVector v1{ArenaAllocator<int>(&arena1)}, v2{ArenaAllocator<int>(&arena2)};
+    for(int i = 0; i < 100; i++) v1.push_back(i);
+    CHECK(v1.get_allocator().arena() == &arena1 && in_buffer(v1.data(), buf1, sizeof(buf1)));
+    ArenaVector copy(v1);
+    CHECK(copy.get_allocator().arena() == &arena1 && copy.size() == 100);
+    v2 = std::move(v1);
+    CHECK(v2.get_allocator().arena() == &arena2 && in_buffer(v2.data(), buf2, sizeof(buf2)));
+    CHECK(v2.size() == 100 && v2[99] == 99);
+    v2 = copy;
+    CHECK(v2.get_allocator().arena() == &arena2 && v2.size() == 100);
+
+    List<int, ArenaAllocator<ListNode<int>>> l1{ArenaAllocator<ListNode<int>>(&arena1)}, l2{ArenaAllocator<ListNode<int>>(&arena2)};
+    for(int i = 0; i < 10; i++) l1.push_back(i);
+    l2 = std::move(l1);
+    CHECK(l2.get_allocator().arena() == &arena2 && l2.size() == 10 && in_buffer(&*l2.begin(), buf2, sizeof(buf2)));
+
+    typedef ArenaAllocator<RBTreeNode<std::pair<const int, int>>> MapAlloc;
+    Map<int, int, std::less<int>, MapAlloc> m1{MapAlloc(&arena1)}, m2{MapAlloc(&arena2)};
+    for(int i = 0; i < 10; i++) m1[i] = i * i;
+    m2 = std::move(m1);
+    CHECK(m2.get_allocator().arena() == &arena2 && m2.size() == 10 && m2[3] == 9);
+
+    Deque<int, ArenaAllocator> d1{ArenaAllocator<int>(&arena1)};
+    for(int i = 0; i < 1000; i++) d1.push_back(i);
+    Deque<int, ArenaAllocator> d2(d1);
+    CHECK(d2.get_allocator().arena() == &arena1 && d2.size() == 1000 && d2[999] == 999);
+    CHECK(in_buffer(&d1[0], buf1, sizeof(buf1)));
+
+    Vector<int, TaggedAllocator<int>> t1{TaggedAllocator<int>(1)}, t2{TaggedAllocator<int>(2)};
+    t1.push_back(5);
+    t2 = std::move(t1);
+    CHECK(t2.get_allocator().id == 1 && t2.size() == 1 && t2[0] == 5);
+    List<int, TaggedAllocator<ListNode<int>>> tl1{TaggedAllocator<ListNode<int>>(1)}, tl2{TaggedAllocator<ListNode<int>>(2)};
+    tl1.push_back(5);
+    tl2 = std::move(tl1);
+    CHECK(tl2.get_allocator().id == 1 && tl2.size() == 1);
+    typedef TaggedAllocator<RBTreeNode<std::pair<const int, int>>> TaggedMapAlloc;
+    Map<int, int, std::less<int>, TaggedMapAlloc> tm1{TaggedMapAlloc(1)}, tm2{TaggedMapAlloc(2)};
+    tm1[1] = 5;
+    tm2 = std::move(tm1);
+    CHECK(tm2.get_allocator().id == 1 && tm2.size() == 1 && tm2[1] == 5);
+    Deque<int, TaggedAllocator> td1{TaggedAllocator<int>(1)}, td2{TaggedAllocator<int>(2)};
+    td1.push_back(5);
+    td2 = std::move(td1);
+    CHECK(td2.get_allocator().id == 1 && td2.size() == 1 && td2[0] == 5);
+}
+
+void test_deque_move(){
+    Deque<int> a, b;
+    for(int i = 0; i < 100; i++) b.push_back(i);
+    a = std::move(b);
+    CHECK(a.size() == 100 && a.front() == 0 && a.back() == 99);
+    CHECK(b.size() == 0 && b.empty());
+    b.clear();
+    b.push_back(7);
+    CHECK(b.size() == 1 && b.front() == 7);
+    CHECK(a.size() == 100);
+    Deque<int> c(std::move(a));
+    CHECK(a.empty() && c.size() == 100);
+    a.push_front(1);
+    CHECK(a.size() == 1 && a.back() == 1);
+}
+
+void test_arena(){
+    alignas(16) char buffer[256];
+    MonotonicArena arena(buffer, sizeof(buffer));
+    void* a = arena.allocate(10, 1);
+    void* b = arena.allocate(8, 8);
+    CHECK(a == buffer && in_buffer(static_cast<char*>(b), buffer, sizeof(buffer)));
+    CHECK(reinterpret_cast<uintptr_t>(b) % 8 == 0 && static_cast<char*>(b) >= buffer + 10);
+    void* big = arena.allocate(1000, 64);
+    CHECK(!in_buffer(static_cast<char*>(big), buffer, sizeof(buffer)) && reinterpret_cast<uintptr_t>(big) % 64 == 0);
+    std::memset(big, 0, 1000);
+    for(int i = 0; i < 100; i++) std::memset(arena.allocate(100), i, 100);
+    arena.release();
+    CHECK(arena.allocate(1, 1) == buffer);
+
+    MonotonicArena heap_arena;
+    {
+        typedef Map<int, int, std::less<int>, ArenaAllocator<RBTreeNode<std::pair<const int, int>>>> ArenaMap;
+        ArenaMap m{ArenaAllocator<RBTreeNode<std::pair<const int, int>>>(&heap_arena)};
+        for(int i = 0; i < 1000; i++) m[i] = -i;
+        CHECK(m.size() == 1000 && m[500] == -500);
+        Vector<std::string, ArenaAllocator<std::string>> words{ArenaAllocator<std::string>(&heap_arena)};
+        for(int i = 0; i < 100; i++) words.push_back(std::string(40, char('a' + i % 26)));
+        CHECK(words.size() == 100 && words[27] == std::string(40, 'b'));
+    }
+    heap_arena.release();
+    CHECK(ArenaAllocator<int>(&heap_arena) == ArenaAllocator<int>(&heap_arena));
+    CHECK(ArenaAllocator<int>(&heap_arena) != ArenaAllocator<int>(&arena));
+}
+
+template <typename T>
+bool aligned_to(const T* p, size_t align){
+    return reinterpret_cast<uintptr_t>(p) % align == 0;
+}
+
+void test_alignment(){
+    struct alignas(64) Line{ long x;};
+    struct alignas(16) Pair{ long a, b;};
+    struct alignas(32) Wide{ char bytes[96];};
+
+    Line* line = NewAllocator<Line>::allocate(3);
+    CHECK(aligned_to(line, 64));
+    NewAllocator<Line>::deallocate(line, 3);
+
+    Vector<Line> lines;
+    for(int i = 0; i < 100; i++){
+        lines.push_back(Line{i});
+        CHECK(aligned_to(lines.data(), 64));
+    }
+    CHECK(lines[99].x == 99);
+
+    int* ints = AlignedAllocator<int, 128>::allocate(10);
+    CHECK(aligned_to(ints, 128));
+    AlignedAllocator<int, 128>::deallocate(ints, 10);
+    Vector<double, CacheAlignedAllocator<double>> doubles(100, 1.5);
+    CHECK(aligned_to(doubles.data(), CACHE_LINE_SIZE));
+
+    bool pool_aligned = true;
+    Vector<Pair*> pairs;
+    Vector<Wide*> wides;
+    for(int i = 0; i < 200; i++){
+        // An odd-sized object in between knocks the free pointer off alignment.
+        PollAllocator<char>::deallocate(PollAllocator<char>::allocate(3), 3);
+        pairs.push_back(PollAllocator<Pair>::allocate(1));
+        wides.push_back(PollAllocator<Wide>::allocate(1));
+        pool_aligned = pool_aligned && aligned_to(pairs.back(), 16) && aligned_to(wides.back(), 32);
+    }
+    CHECK(pool_aligned);
+    for(Pair* p : pairs) PollAllocator<Pair>::deallocate(p, 1);
+    for(Wide* w : wides) PollAllocator<Wide>::deallocate(w, 1);
+
+    Deque<Line> deque;
+    for(int i = 0; i < 50; i++) deque.push_back(Line{i});
+    CHECK(aligned_to(&deque[0], 64) && aligned_to(&deque[49], 64));
+}
+
+// NewAllocator that counts the blocks it has handed out, in total and not
+// yet freed.
+template <typename T>
+struct CountingAllocator: NewAllocator<T>{
+    static long live;
+    static long allocations;
+    CountingAllocator(){}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&){}
+    static T* allocate(size_t obj_nr, void* = nullptr){ live++; allocations++; return NewAllocator<T>::allocate(obj_nr);}
+    static void deallocate(T* p, size_t obj_nr){ live--; NewAllocator<T>::deallocate(p, obj_nr);}
+};
+template <typename T>
+long CountingAllocator<T>::live = 0;
+template <typename T>
+long CountingAllocator<T>::allocations = 0;
+
+// Throws from the copy constructor once countdown copies have been made.
+struct ThrowOnCopy{
+    static int countdown, live;
+    int value;
+    ThrowOnCopy(int v = 0):value(v){ live++;}
+    ThrowOnCopy(const ThrowOnCopy& other):value(other.value){
+        if(--countdown == 0) throw std::runtime_error("copy");
+        live++;
+    }
+    ThrowOnCopy& operator=(const ThrowOnCopy&) = default;
+    ~ThrowOnCopy(){ live--;}
+};
+int ThrowOnCopy::countdown = -1, ThrowOnCopy::live = 0;
+
+// CountingAllocator that also counts allocate_batch() calls.
+template <typename T>
+struct BatchCountingAllocator: CountingAllocator<T>{
+    typedef CountingAllocator<T> base;
+    static long batches;
+    BatchCountingAllocator(){}
+    template <typename U>
+    BatchCountingAllocator(const BatchCountingAllocator<U>&){}
+    // Nodes of a batch are freed one by one, so each counts as a block.
+    static T* allocate_batch(size_t obj_nr){
+        batches++;
+        base::live += obj_nr;
+        base::allocations += obj_nr;
+        return NewAllocator<T>::allocate_batch(obj_nr);
+    }
+    static void deallocate_batch(T* first, T* last, size_t obj_nr){ base::live -= obj_nr; NewAllocator<T>::deallocate_batch(first, last, obj_nr);}
+};
+template <typename T>
+long BatchCountingAllocator<T>::batches = 0;
+
+void test_batch_nodes(){
+    typedef BatchCountingAllocator<ListNode<int>> ListAlloc;
+    {
+        List<int, ListAlloc> l;
+        l.insert(l.end(), 100, 7);
+        CHECK(ListAlloc::batches == 1 && ListAlloc::live == 100 && l.size() == 100);
+        int more[] = {1, 2, 3};
+        l.insert(l.begin(), more, more + 3);
+        CHECK(ListAlloc::batches == 2 && ListAlloc::live == 103 && *l.begin() == 1);
+        std::istringstream in("4 5");
+        l.insert(l.begin(), std::istream_iterator<int>(in), std::istream_iterator<int>());
+        CHECK(ListAlloc::batches == 2 && l.size() == 105 && *l.begin() == 4);
+        l.insert(l.begin(), more, more);
+        CHECK(ListAlloc::batches == 2 && l.size() == 105);
+    }
+    CHECK(ListAlloc::live == 0);
+
+    typedef BatchCountingAllocator<ListNode<ThrowOnCopy>> ThrowListAlloc;
+    {
+        ThrowOnCopy src[] = {1, 2, 3, 4, 5, 6};
+        List<ThrowOnCopy, ThrowListAlloc> l;
+        ThrowOnCopy::countdown = 5;
+        CHECK(throws<std::runtime_error>([&]{ l.insert(l.end(), src, src + 6);}));
+        ThrowOnCopy::countdown = -1;
+        CHECK(l.size() == 4 && ThrowListAlloc::live == 4);
+    }
+    CHECK(ThrowListAlloc::live == 0);
+
+    typedef BatchCountingAllocator<RBTreeNode<std::pair<const int, int>>> MapAlloc;
+    {
+        Map<int, int, std::less<int>, MapAlloc> m;
+        for(int i = 0; i < 100; i++) m[i] = i;
+        long batches = MapAlloc::batches;
+        Map<int, int, std::less<int>, MapAlloc> copy(m);
+        CHECK(MapAlloc::batches == batches + 1 && MapAlloc::live == 200);
+        CHECK(copy.size() == 100 && copy[42] == 42);
+        copy.clear();
+        CHECK(MapAlloc::live == 100 && copy.empty());
+    }
+    CHECK(MapAlloc::live == 0);
+
+    typedef BatchCountingAllocator<RBTreeNode<std::pair<const int, ThrowOnCopy>>> ThrowMapAlloc;
+    {
+        Map<int, ThrowOnCopy, std::less<int>, ThrowMapAlloc> m;
+        for(int i = 0; i < 20; i++) m.insert(std::make_pair(i, ThrowOnCopy(i)));
+        ThrowOnCopy::countdown = 10;
+        CHECK(throws<std::runtime_error>([&]{ Map<int, ThrowOnCopy, std::less<int>, ThrowMapAlloc> copy(m);}));
+        ThrowOnCopy::countdown = -1;
+        CHECK(ThrowMapAlloc::live == 20);
+    }
+    CHECK(ThrowMapAlloc::live == 0);
+}
+
+// Counts the special member calls made on it.
+struct Tracked{
+    static int moves, copies, live;
+    int value;
+    Tracked(int v):value(v){ live++;}
+    Tracked(const Tracked& other):value(other.value){ copies++; live++;}
+    Tracked(Tracked&& other) noexcept:value(other.value){ moves++; live++;}
+    Tracked& operator=(const Tracked&) = default;
+    Tracked& operator=(Tracked&&) = default;
+    ~Tracked(){ live--;}
+    static void reset(){ moves = copies = 0;}
+};
+int Tracked::moves = 0, Tracked::copies = 0, Tracked::live = 0;
+
+// Owns a heap int; relocating it is a plain byte copy.
+struct OwnsInt{
+    static int moves;
+    int* p;
+    OwnsInt(int v):p(new int(v)){}
+    OwnsInt(const OwnsInt& other):p(new int(*other.p)){}
+    OwnsInt(OwnsInt&& other) noexcept:p(other.p){ other.p = nullptr; moves++;}
+    OwnsInt& operator=(OwnsInt other){ std::swap(p, other.p); return *this;}
+    ~OwnsInt(){ delete p;}
+};
+int OwnsInt::moves = 0;
+
+template <>
+struct is_trivially_relocatable<OwnsInt>: std::true_type{};
+
+// Move-only, and its move constructor throws once countdown moves have been
+// made, so containers must move it on growth without the nothrow path.
+struct ThrowOnMove{
+    static int countdown, live;
+    int value;
+    ThrowOnMove(int v):value(v){ live++;}
+    ThrowOnMove(ThrowOnMove&& other):value(other.value){
+        if(--countdown == 0) throw std::runtime_error("move");
+        live++;
+    }
+    ThrowOnMove(const ThrowOnMove&) = delete;
+    ThrowOnMove& operator=(ThrowOnMove&&) = default;
+    ~ThrowOnMove(){ live--;}
+};
+int ThrowOnMove::countdown = -1, ThrowOnMove::live = 0;
+
+static_assert(!is_nothrow_relocatable<ThrowOnMove>::value, "a throwing move is not a relocation");
+
+void test_vector_relocate(){
+    {
+        Vector<Tracked> v;
+        for(int i = 0; i < 100; i++) v.push_back(Tracked(i));
+        Tracked::reset();
+        v.reserve(v.capacity() + 1);
+        CHECK(Tracked::copies == 0 && Tracked::moves == 100 && Tracked::live == 100);
+        Tracked::reset();
+        v.insert(v.begin(), Tracked(-1));
+        CHECK(Tracked::copies == 0 && v[0].value == -1 && v[100].value == 99);
+    }
+    CHECK(Tracked::live == 0);
+
+    {
+        Vector<OwnsInt> v;
+        for(int i = 0; i < 100; i++) v.emplace_back(i);
+        v.reserve(1000);
+        CHECK(OwnsInt::moves == 0);
+        v.insert(v.begin() + 50, OwnsInt(-1));
+        bool intact = true;
+        for(int i = 0; i < 101; i++) intact = intact && *v[i].p == (i < 50 ? i : i == 50 ? -1 : i - 1);
+        CHECK(intact);
+    }
+
+    // ThrowOnCopy has no noexcept move, so growth copies and leaves the
+    // vector untouched when a copy throws.
+    Vector<ThrowOnCopy> v;
+    v.reserve(4);
+    for(int i = 0; i < 4; i++) v.push_back(ThrowOnCopy(i));
+    ThrowOnCopy::countdown = 3;
+    CHECK(throws<std::runtime_error>([&]{ v.push_back(ThrowOnCopy(4));}));
+    ThrowOnCopy::countdown = -1;
+    CHECK(v.size() == 4 && v.capacity() == 4 && v[0].value == 0 && v[3].value == 3);
+
+    // A move-only type whose move throws: growth moves, and a failed move
+    // keeps the old storage and frees the new one (the basic guarantee).
+    typedef CountingAllocator<ThrowOnMove> MoveAlloc;
+    {
+        Vector<ThrowOnMove, MoveAlloc> m;
+        m.reserve(4);
+        for(int i = 0; i < 4; i++) m.emplace_back(i);
+        for(int countdown : {1, 3}){
+            ThrowOnMove::countdown = countdown;
+            CHECK(throws<std::runtime_error>([&]{ m.emplace(m.begin() + 2, 9);}));
+            ThrowOnMove::countdown = -1;
+            CHECK(m.size() == 4 && m.capacity() == 4 && ThrowOnMove::live == 4 && MoveAlloc::live == 1);
+        }
+        m.emplace(m.begin() + 2, 9);
+        CHECK(m.size() == 5 && m[2].value == 9 && m[4].value == 3 && MoveAlloc::live == 1);
+    }
+    CHECK(ThrowOnMove::live == 0 && MoveAlloc::live == 0);
+}
+
+Vector<std::string> numbers(int first, int last){
+    Vector<std::string> v;
+    for(int i = first; i < last; i++) v.push_back(std::to_string(i));
+    return v;
+}
+
+void test_vector_emplace(){
+    Vector<std::string> v;
+    v.push_back(std::string(50, 'a'));
+    while(v.size() < v.capacity()) v.push_back(std::string(50, 'b'));
+    // At capacity: the copy has to be made before the old storage goes.
+    v.push_back(v[0]);
+    CHECK(v.back() == std::string(50, 'a'));
+    while(v.size() < v.capacity()) v.emplace_back(10, 'c');
+    v.emplace_back(v[0]);
+    CHECK(v.back() == std::string(50, 'a'));
+    v.emplace(v.begin(), v.back());
+    CHECK(v[0] == std::string(50, 'a') && v[1] == std::string(50, 'a'));
+    v.reserve(v.size() + 1);
+    v.emplace(v.begin() + 1, v.back());
+    CHECK(v[1] == std::string(50, 'a'));
+    std::string& last = v.emplace_back(3, 'z');
+    CHECK(&last == &v.back() && last == "zzz");
+
+    Tracked::reset();
+    {
+        Vector<Tracked> t;
+        t.reserve(4);
+        Tracked x(1);
+        t.push_back(std::move(x));
+        t.push_back(x);
+        t.emplace_back(3);
+        CHECK(Tracked::moves == 1 && Tracked::copies == 1 && t.size() == 3 && t[2].value == 3);
+        t.emplace(t.begin() + 1, 2);
+        CHECK(t[0].value == 1 && t[1].value == 2 && t[2].value == 1 && t[3].value == 3);
+        t.pop_back();
+        CHECK(t.size() == 3 && Tracked::live == 4);
+    }
+    CHECK(Tracked::live == 0);
+
+    // The fill insert copies value aside before shifting elements.
+    Vector<std::string> r = numbers(0, 10);
+    r.insert(r.begin(), 3, r[9]);
+    CHECK(r.size() == 13 && r[0] == "9" && r[2] == "9" && r[3] == "0");
+    r.insert(r.end() - 1, 5, r.back());
+    CHECK(r.size() == 18 && r[12] == "9" && r[16] == "9" && r[11] == "8");
+    // resize shrinks as well as grows.
+    r.resize(4);
+    CHECK(r.size() == 4 && r[3] == "0");
+    r.resize(6, "q");
+    CHECK(r.size() == 6 && r[5] == "q");
+}
+
+void test_small_vector(){
+    typedef SmallVector<int, 4, CountingAllocator<int>> Small;
+    typedef CountingAllocator<int> Alloc;
+    {
+        std::istringstream in("1 2 3 4 5 6");
+        Small a{std::istream_iterator<int>(in), std::istream_iterator<int>()};
+        CHECK(a.size() == 6 && a[0] == 1 && a[5] == 6 && !a.is_inline());
+        const Small& ca = a;
+        CHECK(ca[2] == 3 && ca.front() == 1 && ca.back() == 6);
+
+        std::istringstream none("");
+        Small e{std::istream_iterator<int>(none), std::istream_iterator<int>()};
+        CHECK(e.empty() && e.is_inline());
+        Small e2(a.begin(), a.begin());
+        CHECK(e2.empty() && e2.is_inline());
+
+        Small s(2, 9);
+        Small t(std::move(s));
+        CHECK(t.size() == 2 && t.is_inline() && s.empty() && s.is_inline());
+        s.push_back(1);
+        CHECK(s.size() == 1 && s[0] == 1);
+        Small h(std::move(a));
+        CHECK(h.size() == 6 && a.empty() && a.is_inline());
+        a.append_range(h);
+        CHECK(a.size() == 6 && a[5] == 6);
+
+        Small g(4, 7);
+        g.push_back(g[0]);
+        CHECK(g.size() == 5 && g[4] == 7);
+        g.insert(g.begin(), 3, g[1]);
+        CHECK(g.size() == 8 && g[0] == 7 && g[7] == 7);
+
+        int more[] = {10, 11, 12};
+        g.insert(g.begin() + 1, more, more + 3);
+        CHECK(g.size() == 11 && g[1] == 10 && g[3] == 12 && g[4] == 7);
+        std::istringstream in2("20 21");
+        g.insert(g.begin(), std::istream_iterator<int>(in2), std::istream_iterator<int>());
+        CHECK(g.size() == 13 && g[0] == 20 && g[1] == 21 && g[2] == 7);
+        g.assign(2, g[2]);
+        CHECK(g.size() == 2 && g[0] == 7 && g[1] == 7);
+        g.assign(more, more + 3);
+        CHECK(g.size() == 3 && g[2] == 12);
+        std::istringstream in3("1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20");
+        g.assign(std::istream_iterator<int>(in3), std::istream_iterator<int>());
+        CHECK(g.size() == 20 && g[19] == 20);
+        g.resize(2);
+        CHECK(g.size() == 2 && g[1] == 2);
+    }
+    CHECK(Alloc::live == 0);
+
+    ThrowOnCopy src[] = {1, 2, 3, 4, 5, 6};
+    ThrowOnCopy::countdown = 5;
+    CHECK(throws<std::runtime_error>([&]{ SmallVector<ThrowOnCopy, 2, CountingAllocator<ThrowOnCopy>> v(src, src + 6);}));
+    CHECK(CountingAllocator<ThrowOnCopy>::live == 0);
+    ThrowOnCopy::countdown = 5;
+    CHECK(throws<std::runtime_error>([&]{ Vector<ThrowOnCopy, CountingAllocator<ThrowOnCopy>> v(src, src + 6);}));
+    CHECK(CountingAllocator<ThrowOnCopy>::live == 0);
+    ThrowOnCopy::countdown = -1;
+
+    // Leaving the inline buffer moves a move-only type; a throwing move
+    // leaves the elements inline.
+    typedef CountingAllocator<ThrowOnMove> MoveAlloc;
+    {
+        SmallVector<ThrowOnMove, 2, MoveAlloc> m;
+        m.emplace_back(1);
+        m.emplace_back(2);
+        ThrowOnMove::countdown = 2;
+        CHECK(throws<std::runtime_error>([&]{ m.emplace_back(3);}));
+        ThrowOnMove::countdown = -1;
+        CHECK(m.is_inline() && m.size() == 2 && ThrowOnMove::live == 2 && MoveAlloc::live == 0);
+        m.emplace_back(3);
+        CHECK(!m.is_inline() && m.size() == 3 && m[0].value == 1 && m[2].value == 3);
+    }
+    CHECK(ThrowOnMove::live == 0 && MoveAlloc::live == 0);
+}
+
+void test_vector_simd(){
+    Vector<int> a(100, 2), b(100, 3), c(3, 1), empty;
+    CHECK(a.dot(b) == 600);
+    CHECK(throws<std::length_error>([&]{ a.dot(c);}));
+    CHECK(throws<std::length_error>([&]{ a.add(c);}));
+    CHECK(a.sum() == 200);
+    a.add(b);
+    CHECK(a.min() == 5 && a.max() == 5);
+    CHECK(throws<std::length_error>([&]{ empty.min();}));
+    CHECK(throws<std::length_error>([&]{ empty.max();}));
+    CHECK(empty.sum() == 0 && empty.count(1) == 0 && empty.find(1) == empty.end());
+    CHECK(!a.equal(c) && empty.equal(Vector<int>()));
+}
+
+// Runs every kernel on every length up to 70, so each vector width sees
+// full vectors, tails and arrays shorter than one vector.
+template <typename T>
+bool simd_matches_scalar(){
+    bool ok = true;
+    for(size_t n = 1; n <= 70; n++){
+        Vector<T> a, b;
+        for(size_t i = 0; i < n; i++){
+            a.push_back(T((i * 7) % 13) - T(5));
+            b.push_back(T(i % 3));
+        }
+        T sum = 0, dot = 0, lo = a[0], hi = a[0];
+        size_t count = 0, first = n;
+        for(size_t i = 0; i < n; i++){
+            sum += a[i];
+            dot += a[i] * b[i];
+            lo = std::min(lo, a[i]);
+            hi = std::max(hi, a[i]);
+            if(a[i] == T(2)){
+                count++;
+                if(first == n) first = i;
+            }
+        }
+        ok = ok && a.sum() == sum && a.dot(b) == dot && a.min() == lo && a.max() == hi;
+        ok = ok && a.count(T(2)) == count && size_t(a.find(T(2)) - a.begin()) == first;
+        Vector<T> c(a);
+        ok = ok && c.equal(a);
+        c[n - 1] += T(1);
+        ok = ok && !c.equal(a);
+        c.add(b);
+        c.scale(T(2));
+        for(size_t i = 0; i < n; i++) ok = ok && c[i] == (a[i] + b[i] + (i == n - 1 ? T(1) : T(0))) * T(2);
+        c.fill(T(3));
+        ok = ok && c.count(T(3)) == n;
+    }
+    return ok;
+}
+
+void test_simd_levels(){
+    for(SimdLevel level : {SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2}){
+        simd_set_level(level);
+        CHECK(simd_matches_scalar<int>());
+        CHECK(simd_matches_scalar<short>());
+        CHECK(simd_matches_scalar<long>());
+        CHECK(simd_matches_scalar<float>());
+        CHECK(simd_matches_scalar<double>());
+    }
+    simd_set_level(simd_detect());
+}
+
+void test_mapped_vector(){
+    MappedVector<int> anon;
+    for(int i = 0; i < 5000; i++) anon.push_back(i);
+    CHECK(!anon.is_open() && anon.size() == 5000 && anon[4999] == 4999);
+
+    const char* path = "/tmp/mapped_vector_test.bin";
+    ::unlink(path);
+    {
+        MappedVector<int> m(path);
+        m.push_back(42);
+        while(m.size() < m.capacity()) m.push_back(int(m.size()));
+        m.emplace_back(m[0]);
+        CHECK(m.back() == 42);
+        while(m.size() < m.capacity()) m.push_back(int(m.size()));
+        m.push_back(m[0]);
+        CHECK(m.back() == 42);
+        while(m.size() < m.capacity()) m.push_back(int(m.size()));
+        {
+            size_t n = m.size();
+            m.append(m.begin(), m.begin() + 3);
+            CHECK(m.size() == n + 3 && m[n] == 42 && m[n + 1] == 1 && m[n + 2] == 2);
+        }
+        m.append(m.begin(), m.begin());
+        Vector<int> empty;
+        m.append(empty.begin(), empty.end());
+        m.resize(10);
+    }
+    {
+        MappedVector<int> m(path);
+        CHECK(m.is_open() && m.size() == 10 && m[0] == 42 && m[9] == 9);
+        m.erase(m.begin(), m.begin() + 2);
+        CHECK(m.size() == 8 && m[0] == 2);
+        m.resize(12, 7);
+        CHECK(m[11] == 7 && m[7] == 9);
+        struct stat before, after;
+        ::stat(path, &before);
+        m.shrink_to_fit();
+        ::stat(path, &after);
+        CHECK(m.capacity() == 12 && after.st_size < before.st_size);
+        MappedVector<int> moved(std::move(m));
+        CHECK(!m.is_open() && m.empty() && moved.is_open() && moved.size() == 12);
+        m.push_back(1);
+        m.swap(moved);
+        CHECK(m.is_open() && m.size() == 12 && moved.size() == 1 && !moved.is_open());
+    }
+    {
+        MappedVector<int> m(path);
+        CHECK(m.size() == 12 && m[0] == 2 && m[11] == 7);
+        CHECK(throws<std::runtime_error>([&]{ MappedVector<double> wrong(path);}));
+    }
+    ::unlink(path);
+}
+
+template <typename CONTAINER>
+bool parallel_matches_serial(CONTAINER& c, size_t n){
+    for(size_t i = 0; i < n; i++) c.push_back(long((i * 2654435761u) % 100003));
+    bool ok = parallel_reduce(c.begin(), c.end(), 0L) == std::accumulate(c.begin(), c.end(), 0L);
+    ok = ok && parallel_reduce(c.begin(), c.end(), -1L, [](long a, long b){ return std::max(a, b);}) == (n == 0 ? -1L : *std::max_element(c.begin(), c.end()));
+    std::vector<long> scan(n), expect(n);
+    parallel_inclusive_scan(c.begin(), c.end(), scan.begin());
+    std::inclusive_scan(c.begin(), c.end(), expect.begin());
+    ok = ok && scan == expect;
+    std::vector<long> doubled(n);
+    parallel_transform(c.begin(), c.end(), doubled.begin(), [](long x){ return 2 * x;});
+    for(size_t i = 0; i < n; i++) ok = ok && doubled[i] == 2 * c[i];
+    parallel_for_each(c.begin(), c.end(), [](long& x){ x = -x;});
+    ok = ok && (n == 0 || c[n - 1] <= 0);
+    std::vector<long> sorted(c.begin(), c.end());
+    std::sort(sorted.begin(), sorted.end(), std::greater<long>());
+    parallel_sort(c.begin(), c.end(), std::greater<long>());
+    ok = ok && std::equal(sorted.begin(), sorted.end(), c.begin());
+    return ok;
+}
+
+void test_parallel(){
+    CHECK(TaskScheduler::instance().thread_count() == 4);
+    for(size_t n : {size_t(0), size_t(1), size_t(1000), size_t(PARALLEL_SERIAL_THRESHOLD + 12345)}){
+        Vector<long> v;
+        Deque<long> d;
+        CHECK(parallel_matches_serial(v, n));
+        CHECK(parallel_matches_serial(d, n));
+    }
+    Vector<long> v(100000, 0);
+    std::iota(v.begin(), v.end(), 0L);
+    CHECK(throws<std::runtime_error>([&]{
+        parallel_for_each(v.begin(), v.end(), [](long x){ if(x == 77777) throw std::runtime_error("parallel_for_each");});
+    }));
+}
+
+void test_soa_vector(){
+    typedef BasicSoaVector<CountingAllocator, int, double, char> Soa;
+    typedef Soa::allocator_type Alloc;
+    {
+        Soa a;
+        for(int i = 0; i < 1000; i++) a.emplace_back(i, i * 0.5, char('a' + i % 26));
+        CHECK(Alloc::live == 1);
+        CHECK(reinterpret_cast<uintptr_t>(a.column<1>()) % Soa::COLUMN_ALIGN == 0);
+        CHECK(reinterpret_cast<uintptr_t>(a.column<2>()) % Soa::COLUMN_ALIGN == 0);
+        Soa b(a);
+        CHECK(Alloc::live == 2 && b.size() == 1000 && b.get<0>(999) == 999 && b.get<2>(1) == 'b');
+        Soa c(std::move(a));
+        CHECK(a.empty() && c.size() == 1000);
+        a.emplace_back(a.size(), 1.0, 'x');
+        CHECK(a.size() == 1 && a.get<0>(0) == 0);
+        a = std::move(c);
+        CHECK(a.size() == 1000 && c.empty());
+        b = a;
+        CHECK(b.size() == 1000 && b.get<1>(10) == 5.0);
+        b.push_back(b[0]);
+        CHECK(b.size() == 1001 && b.get<0>(1000) == 0);
+        a.swap(c);
+        CHECK(a.empty() && c.size() == 1000);
+        Soa d(3, Soa::value_type(7, 2.0, 'z'));
+        CHECK(d.size() == 3 && d.get<0>(2) == 7);
+    }
+    CHECK(Alloc::live == 0);
+    SoaVector<int, float> plain;
+    plain.emplace_back(1, 2.0f);
+    CHECK(plain.size() == 1 && plain.get<1>(0) == 2.0f);
+
+    // A field whose move throws: a failed growth keeps the old block.
+    typedef BasicSoaVector<CountingAllocator, ThrowOnMove, int> MoveSoa;
+    typedef MoveSoa::allocator_type MoveAlloc;
+    {
+        MoveSoa m;
+        m.reserve(2);
+        m.emplace_back(1, 10);
+        m.emplace_back(2, 20);
+        ThrowOnMove::countdown = 2;
+        CHECK(throws<std::runtime_error>([&]{ m.reserve(8);}));
+        ThrowOnMove::countdown = -1;
+        CHECK(m.size() == 2 && m.capacity() == 2 && ThrowOnMove::live == 2 && MoveAlloc::live == 1);
+        m.reserve(8);
+        CHECK(m.capacity() == 8 && m.get<0>(1).value == 2 && m.get<1>(1) == 20);
+    }
+    CHECK(ThrowOnMove::live == 0 && MoveAlloc::live == 0);
+}
+
+void test_soa_vector_rows(){
+    typedef BasicSoaVector<CountingAllocator, std::string, int> Soa;
+    typedef Soa::allocator_type Alloc;
+    {
+        Soa s;
+        s.emplace_back(std::string(40, 'a'), 0);
+        while(s.size() < s.capacity()) s.emplace_back(std::string(40, 'b'), int(s.size()));
+        // At capacity the arguments still refer into the old block.
+        s.emplace_back(s.get<0>(0), s.get<1>(0));
+        CHECK(s.get<0>(s.size() - 1) == std::string(40, 'a') && s.get<1>(s.size() - 1) == 0);
+        s.emplace_back(std::string(40, 'b'), 1);
+        while(s.size() < s.capacity()) s.emplace_back(std::string(40, 'c'), int(s.size()));
+        s.push_back(s[s.size() - 1]);
+        CHECK(s.get<0>(s.size() - 1) == std::string(40, 'c') && s.get<1>(s.size() - 1) == s.get<1>(s.size() - 2));
+
+        int last = std::get<1>(s.back());
+        for(auto row : s) std::get<1>(row) += 100;
+        CHECK(s.get<1>(0) == 100 && std::get<1>(s.back()) == last + 100);
+        const Soa& cs = s;
+        int total = 0;
+        for(auto it = cs.begin(); it != cs.end(); ++it) total += std::get<1>(*it);
+        CHECK(total >= int(s.size()) * 100);
+        CHECK(s.end() - s.begin() == std::ptrdiff_t(s.size()));
+
+        size_t n = s.size();
+        s.pop_back();
+        CHECK(s.size() == n - 1);
+        s.resize(3);
+        CHECK(s.size() == 3 && s.get<0>(0) == std::string(40, 'a'));
+        s.resize(50, Soa::value_type("z", 7));
+        CHECK(s.size() == 50 && s.get<0>(49) == "z" && s.get<1>(49) == 7);
+        std::get<0>(s[49]) = "y";
+        CHECK(s.get<0>(49) == "y");
+        s.clear();
+        CHECK(s.empty() && s.capacity() >= 50);
+    }
+    CHECK(Alloc::live == 0);
+}
+
+void test_vector_ranges(){
+    std::vector<std::string> src;
+    for(int i = 100; i < 110; i++) src.push_back(std::to_string(i));
+
+    // Tail longer than the range, tail shorter than it, and growth.
+    Vector<std::string> v = numbers(0, 20);
+    v.reserve(100);
+    v.insert(v.begin() + 5, src.begin(), src.begin() + 3);
+    CHECK(v.size() == 23 && v[4] == "4" && v[5] == "100" && v[7] == "102" && v[8] == "5" && v[22] == "19");
+    v.insert(v.end() - 2, src.begin(), src.end());
+    CHECK(v.size() == 33 && v[20] == "17" && v[21] == "100" && v[30] == "109" && v[31] == "18");
+    Vector<std::string> w = numbers(0, 4);
+    size_t cap = w.capacity();
+    auto it = w.insert(w.begin() + 1, src.begin(), src.end());
+    CHECK(w.capacity() > cap && *it == "100" && w.size() == 14 && w[11] == "1" && w[13] == "3");
+    CHECK(w.insert(w.begin(), src.begin(), src.begin()) == w.begin() && w.size() == 14);
+
+    Vector<int> empty;
+    int nums[] = {1, 2, 3, 4, 5};
+    empty.insert(empty.end(), nums, nums + 5);
+    CHECK(empty.capacity() == 5 && empty.size() == 5);
+
+    std::istringstream in("7 8 9");
+    Vector<int> fromin(nums, nums + 5);
+    auto at = fromin.insert(fromin.begin() + 2, std::istream_iterator<int>(in), std::istream_iterator<int>());
+    CHECK(*at == 7 && fromin.size() == 8 && fromin[1] == 2 && fromin[4] == 9 && fromin[5] == 3);
+    std::istringstream in_ctor("4 5 6");
+    Vector<int> built{std::istream_iterator<int>(in_ctor), std::istream_iterator<int>()};
+    CHECK(built.size() == 3 && built[2] == 6);
+
+    Vector<std::string> a = numbers(0, 10);
+    a.append_range(src);
+    CHECK(a.size() == 20 && a[10] == "100");
+    a.append_range(Vector<std::string>());
+    CHECK(a.size() == 20);
+
+    a.assign(src.begin(), src.begin() + 2);
+    CHECK(a.size() == 2 && a[1] == "101");
+    a.assign(src.begin(), src.end());
+    CHECK(a.size() == 10 && a[9] == "109");
+    a.assign(src.begin(), src.begin());
+    CHECK(a.empty());
+    std::istringstream words("x y z");
+    a.assign(std::istream_iterator<std::string>(words), std::istream_iterator<std::string>());
+    CHECK(a.size() == 3 && a[2] == "z");
+    a.assign(50, a[0]);
+    CHECK(a.size() == 50 && a[49] == "x");
+    a.assign(2, a[49]);
+    CHECK(a.size() == 2 && a[1] == "x");
+}
+
+void test_deque_spare_blocks(){
+    typedef CountingAllocator<int> Alloc;
+    typedef Deque<int, CountingAllocator> CountingDeque;
+    const size_t block = CountingDeque::block::SIZE;
+    {
+        CountingDeque q;
+        // A queue that keeps about two blocks' worth of elements and slides
+        // through many blocks.
+        int pushed = 0, popped = 0;
+        for(size_t i = 0; i < 2 * block; i++) q.push_back(pushed++);
+        long before = Alloc::allocations;
+        bool fifo = true;
+        for(size_t i = 0; i < 50 * block; i++){
+            q.push_back(pushed++);
+            fifo = fifo && q.front() == popped++;
+            q.pop_front();
+        }
+        CHECK(fifo && Alloc::allocations - before <= 2);
+        CHECK(q.size() == 2 * block);
+        long in_use = Alloc::live;
+        while(!q.empty()) q.pop_back();
+        q.shrink_to_fit();
+        CHECK(Alloc::live < in_use && Alloc::live <= 1);
+        q.push_front(1);
+        q.push_back(2);
+        CHECK(q.front() == 1 && q.back() == 2);
+    }
+    CHECK(Alloc::live == 0 && CountingAllocator<int*>::live == 0);
+}
+
+static_assert(DequeBlock<int, 512>::SIZE == 128 && DequeBlock<int, 512>::SHIFT == 7, "");
+static_assert(DequeBlock<char[24], 512>::SIZE == 16, "rounds down to a power of two");
+static_assert(DequeBlock<char[200], 512>::SIZE == DEQUE_MIN_BLOCK_ELEMENTS, "");
+
+template <typename T>
+T make_value(int i){
+    if constexpr(std::is_same<T, std::string>::value) return std::to_string(i);
+    else return T(i);
+}
+
+// Checks indexing and iterator arithmetic of a Deque with BLOCK_BYTES-sized
+// blocks against std::deque, growing at both ends.
+template <typename T, size_t BLOCK_BYTES>
+bool deque_matches_std(){
+    Deque<T, NewAllocator, BLOCK_BYTES> d;
+    std::deque<T> expect;
+    for(int i = 0; i < 300; i++){
+        if(i % 3 == 0){
+            d.push_front(make_value<T>(i));
+            expect.push_front(make_value<T>(i));
+        }else{
+            d.push_back(make_value<T>(i));
+            expect.push_back(make_value<T>(i));
+        }
+    }
+    bool ok = d.size() == expect.size();
+    for(size_t i = 0; i < expect.size(); i++) ok = ok && d[i] == expect[i];
+    auto first = d.begin();
+    for(ptrdiff_t a = 0; a < ptrdiff_t(expect.size()); a += 7){
+        for(ptrdiff_t b = 0; b <= ptrdiff_t(expect.size()); b += 11){
+            ok = ok && (first + b) - (first + a) == b - a && *(first + a) == expect[a];
+            ok = ok && ((first + b) - (b - a) == first + a);
+        }
+    }
+    ok = ok && d.end() - d.begin() == ptrdiff_t(expect.size()) && std::equal(d.begin(), d.end(), expect.begin());
+    return ok;
+}
+
+struct Wide200{
+    long value;
+    char pad[192];
+    Wide200(long v = 0):value(v){}
+    bool operator==(const Wide200& other) const{ return value == other.value;}
+};
+
+void test_deque_block_size(){
+    CHECK((deque_matches_std<int, 16>()));
+    CHECK((deque_matches_std<int, 512>()));
+    CHECK((deque_matches_std<long, 4096>()));
+    CHECK((deque_matches_std<Wide200, 512>()));
+    CHECK((deque_matches_std<std::string, 64>()));
+}
+
+void test_deque_segmented(){
+    typedef Deque<int, NewAllocator, 64> SmallBlocks;
+    SmallBlocks d;
+    for(int i = 0; i < 200; i++) d.push_back(i);
+    for(int i = 1; i <= 5; i++) d.push_front(-i);
+    std::vector<int> expect(d.begin(), d.end());
+
+    bool ok = true;
+    for(size_t a = 0; a <= expect.size(); a += 13){
+        for(size_t b = a; b <= expect.size(); b += 17){
+            auto first = d.begin() + a, last = d.begin() + b;
+            long sum = 0;
+            segmented_for_each(first, last, [&sum](int x){ sum += x;});
+            ok = ok && sum == std::accumulate(expect.begin() + a, expect.begin() + b, 0L);
+            ok = ok && segmented_accumulate(first, last, 0L) == sum;
+            for(int target : {0, 100, 150, 999}){
+                auto it = segmented_find(first, last, target);
+                auto want = std::find(expect.begin() + a, expect.begin() + b, target);
+                ok = ok && it - d.begin() == want - expect.begin();
+            }
+        }
+    }
+    CHECK(ok);
+
+    Vector<int> out(expect.size(), 0);
+    CHECK(segmented_copy(d.begin(), d.end(), out.begin()) == out.end());
+    CHECK(std::equal(out.begin(), out.end(), expect.begin()));
+    SmallBlocks target(300, -1);
+    auto end = segmented_copy(out.begin() + 3, out.begin() + 100, target.begin() + 7);
+    CHECK(end - target.begin() == 104 && target[6] == -1 && target[7] == expect[3] && target[103] == expect[99] && target[104] == -1);
+    end = segmented_copy(d.begin() + 20, d.begin() + 120, target.begin() + 150);
+    CHECK(end - target.begin() == 250 && target[150] == expect[20] && target[249] == expect[119]);
+
+    // Overlapping moves within one deque, both directions.
+    segmented_move(d.begin() + 10, d.end(), d.begin() + 3);
+    CHECK(d[3] == expect[10] && d[100] == expect[107] && d[197] == expect[204]);
+    for(size_t i = 0; i < expect.size(); i++) d[i] = expect[i];
+    segmented_move_backward(d.begin(), d.end() - 9, d.end());
+    CHECK(d[9] == expect[0] && d[100] == expect[91] && d[204] == expect[195]);
+
+    segmented_fill(d.begin() + 30, d.begin() + 90, 7);
+    CHECK(d[29] != 7 && d[30] == 7 && d[89] == 7 && d[90] != 7);
+
+    typedef Deque<ThrowOnCopy, CountingAllocator, 64> ThrowDeque;
+    Vector<ThrowOnCopy> src;
+    for(int i = 0; i < 100; i++) src.emplace_back(i);
+    ThrowOnCopy::countdown = 60;
+    CHECK(throws<std::runtime_error>([&]{ ThrowDeque bad(src.begin(), src.end());}));
+    ThrowOnCopy::countdown = -1;
+    CHECK(ThrowOnCopy::live == 100 && CountingAllocator<ThrowOnCopy>::live == 0 && CountingAllocator<ThrowOnCopy*>::live == 0);
+    ThrowOnCopy::countdown = 30;
+    CHECK(throws<std::runtime_error>([&]{ ThrowDeque bad(70, src[0]);}));
+    ThrowOnCopy::countdown = -1;
+    CHECK(ThrowOnCopy::live == 100 && CountingAllocator<ThrowOnCopy>::live == 0 && CountingAllocator<ThrowOnCopy*>::live == 0);
+    std::istringstream in("1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20");
+    SmallBlocks from_input{std::istream_iterator<int>(in), std::istream_iterator<int>()};
+    CHECK(from_input.size() == 20 && from_input[0] == 1 && from_input[19] == 20);
+    std::istringstream none("");
+    SmallBlocks empty_input{std::istream_iterator<int>(none), std::istream_iterator<int>()};
+    CHECK(empty_input.empty());
+}
+
+// Random middle inserts and erases, checked against std::deque.
+template <size_t BLOCK_BYTES>
+bool deque_edits_match_std(unsigned seed){
+    std::mt19937 rng(seed);
+    Deque<std::string, NewAllocator, BLOCK_BYTES> d;
+    std::deque<std::string> expect;
+    std::vector<std::string> src;
+    for(int i = 0; i < 40; i++) src.push_back("s" + std::to_string(i));
+    bool ok = true;
+    for(int step = 0; step < 400 && ok; step++){
+        size_t pos = expect.empty() ? 0 : rng() % (expect.size() + 1);
+        size_t count = 1 + rng() % 39;
+        std::string value = std::to_string(step);
+        switch(rng() % 7){
+            case 0:
+                d.insert(d.begin() + pos, value);
+                expect.insert(expect.begin() + pos, value);
+                break;
+            case 1:
+                d.insert(d.begin() + pos, count, value);
+                expect.insert(expect.begin() + pos, count, value);
+                break;
+            case 2:
+                d.insert(d.begin() + pos, src.begin(), src.begin() + count);
+                expect.insert(expect.begin() + pos, src.begin(), src.begin() + count);
+                break;
+            case 3:
+                d.emplace(d.begin() + pos, 3, 'e');
+                expect.emplace(expect.begin() + pos, 3, 'e');
+                break;
+            case 4: case 5:{
+                size_t n = std::min(count, expect.size() - pos);
+                auto it = d.erase(d.begin() + pos, d.begin() + pos + n);
+                expect.erase(expect.begin() + pos, expect.begin() + pos + n);
+                ok = ok && it - d.begin() == ptrdiff_t(pos);
+                break;
+            }
+            case 6:
+                if(!expect.empty()){
+                    size_t from = rng() % expect.size();
+                    std::string copy = expect[from];
+                    d.insert(d.begin() + pos, count % 4 + 1, d[from]);
+                    expect.insert(expect.begin() + pos, count % 4 + 1, copy);
+                }
+                break;
+        }
+        ok = ok && d.size() == expect.size() && std::equal(d.begin(), d.end(), expect.begin());
+    }
+    return ok;
+}
+
+void test_deque_insert_erase(){
+    CHECK(deque_edits_match_std<64>(1));
+    CHECK(deque_edits_match_std<64>(2));
+    CHECK(deque_edits_match_std<512>(3));
+    CHECK(deque_edits_match_std<4096>(4));
+
+    Tracked::reset();
+    {
+        Deque<Tracked> d;
+        std::vector<Tracked> src_empty;
+        for(int i = 0; i < 300; i++) d.emplace_back(i);
+        Tracked::reset();
+        d.emplace(d.begin() + 100, -1);
+        d.emplace(d.begin() + 250, -2);
+        d.erase(d.begin() + 10, d.begin() + 20);
+        d.erase(d.begin() + 200);
+        CHECK(Tracked::copies == 0 && d.size() == 291 && d[90].value == -1);
+        d.emplace(d.begin() + 5, d[200]);
+        CHECK(d[5].value == d[201].value);
+        // Zero-count inserts are checked here rather than against std::deque,
+        // whose libstdc++ version self-move-assigns the tail for them.
+        int at = d[150].value;
+        Tracked::reset();
+        d.insert(d.begin() + 150, 0, d[10]);
+        d.insert(d.begin() + 150, src_empty.begin(), src_empty.end());
+        CHECK(d.size() == 292 && Tracked::moves == 0 && d[150].value == at);
+    }
+    CHECK(Tracked::live == 0);
+
+    Deque<ThrowOnCopy> t;
+    for(int i = 0; i < 100; i++) t.emplace_back(i);
+    ThrowOnCopy one(7);
+    for(size_t pos : {size_t(10), size_t(90)}){
+        ThrowOnCopy::countdown = 5;
+        CHECK(throws<std::runtime_error>([&]{ t.insert(t.begin() + pos, 20, one);}));
+        ThrowOnCopy::countdown = -1;
+        bool same = t.size() == 100;
+        for(int i = 0; same && i < 100; i++) same = t[i].value == i;
+        CHECK(same);
+    }
+}
+
+void test_spsc_ring(){
+    SpscRing<int, 8> r;
+    int in[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+    int out[12] = {};
+    CHECK(r.empty() && !r.try_pop(out[0]));
+    CHECK(r.push_n(in, 12) == 8 && r.size() == 8 && !r.try_push(99));
+    CHECK(r.pop_n(out, 5) == 5 && out[4] == 4);
+    // The next pushes wrap around the end of the slots.
+    CHECK(r.push_n(in + 8, 4) == 4 && r.size() == 7);
+    CHECK(r.pop_n(out, 12) == 7 && out[0] == 5 && out[6] == 11 && r.empty());
+    CHECK(r.pop_n(out, 3) == 0 && r.push_n(in, 0) == 0);
+
+    Tracked::reset();
+    {
+        SpscRing<Tracked, 4> t;
+        Tracked a(1);
+        CHECK(t.try_push(a) && t.try_emplace(2) && t.try_push(Tracked(3)));
+        Tracked got(0);
+        CHECK(t.try_pop(got) && got.value == 1 && t.size() == 2);
+    }
+    // The destructor destroys what was never popped.
+    CHECK(Tracked::live == 0);
+
+    int live = ThrowOnCopy::live;
+    {
+        SpscRing<ThrowOnCopy, 8> t;
+        ThrowOnCopy src[6];
+        ThrowOnCopy::countdown = 3;
+        CHECK(throws<std::runtime_error>([&]{ t.push_n(src, 6);}));
+        ThrowOnCopy::countdown = -1;
+        CHECK(t.empty() && t.push_n(src, 6) == 6);
+    }
+    CHECK(ThrowOnCopy::live == live);
+
+    // One producer and one consumer hand over every value once and in order.
+    const long item_nr = 200000;
+    SpscRing<long, 64>* ring = new SpscRing<long, 64>;
+    std::thread producer([&]{
+        long next = 0;
+        long batch[16];
+        while(next < item_nr){
+            if(next % 3 == 0){
+                ring->push_back(next++);
+            }else{
+                long n = std::min<long>(16, item_nr - next);
+                for(long i = 0; i < n; i++) batch[i] = next + i;
+                next += ring->push_n(batch, n);
+            }
+        }
+    });
+    long expected = 0;
+    bool in_order = true;
+    long batch[16];
+    while(expected < item_nr){
+        size_t n = ring->pop_n(batch, 16);
+        for(size_t i = 0; i < n; i++) in_order = in_order && batch[i] == expected++;
+        long one;
+        if(ring->try_pop(one)) in_order = in_order && one == expected++;
+    }
+    producer.join();
+    CHECK(in_order && expected == item_nr && ring->empty());
+    delete ring;
+
+    Queue<int, SpscRing<int, 16>> q;
+    std::thread feeder([&]{ for(int i = 0; i < 1000; i++) q.push(i);});
+    int sum = 0, seen = 0;
+    while(seen < 1000){
+        if(q.empty()) continue;
+        sum += q.front();
+        q.pop();
+        seen++;
+    }
+    feeder.join();
+    CHECK(sum == 999 * 1000 / 2 && q.empty());
+}
+
+// Throws from its converting constructor but moves without throwing.
+struct NegativeThrows{
+    int value;
+    NegativeThrows(int v = 0):value(v){ if(v < 0) throw std::invalid_argument("negative");}
+};
+
+void test_mpmc_queue(){
+    MpmcQueue<int, 4> q;
+    int got = -1;
+    CHECK(q.empty() && !q.try_pop(got) && got == -1);
+    for(int round = 0; round < 3; round++){
+        int pushed = 0;
+        while(q.try_push(round * 10 + pushed)) pushed++;
+        CHECK(pushed == 4 && q.size() == 4);
+        bool fifo = true;
+        for(int i = 0; i < 4; i++) fifo = fifo && q.try_pop(got) && got == round * 10 + i;
+        CHECK(fifo && q.empty() && !q.try_pop(got));
+    }
+
+    {
+        MpmcQueue<NegativeThrows, 4> t;
+        CHECK(t.try_emplace(1));
+        CHECK(throws<std::invalid_argument>([&]{ t.try_emplace(-1);}));
+        CHECK(throws<std::invalid_argument>([&]{ t.emplace(-2);}));
+        // A failed construction takes no slot, so nothing blocks behind it.
+        NegativeThrows out;
+        CHECK(t.size() == 1 && t.try_emplace(2) && t.try_pop(out) && out.value == 1 && t.try_pop(out) && out.value == 2);
+    }
+
+    Tracked::reset();
+    {
+        MpmcQueue<Tracked, 8> t;
+        for(int i = 0; i < 5; i++) t.emplace(i);
+        Tracked out(0);
+        t.pop(out);
+        CHECK(out.value == 0 && t.size() == 4);
+    }
+    CHECK(Tracked::live == 0);
+
+    // Several producers and consumers on a queue small enough that both
+    // sides park; every value must arrive exactly once.
+    const int producer_nr = 4, consumer_nr = 4, per_producer = 20000;
+    const int item_nr = producer_nr * per_producer;
+    MpmcQueue<int, 8>* shared = new MpmcQueue<int, 8>;
+    std::vector<std::vector<int>> seen(consumer_nr);
+    std::vector<std::thread> threads;
+    for(int p = 0; p < producer_nr; p++){
+        threads.emplace_back([=]{
+            for(int i = 0; i < per_producer; i++){
+                int v = p * per_producer + i;
+                if(i % 2 == 0) shared->push(v);
+                else while(!shared->try_push(v)) std::this_thread::yield();
+            }
+        });
+    }
+    for(int c = 0; c < consumer_nr; c++){
+        threads.emplace_back([=, &seen]{
+            for(int i = 0; i < item_nr / consumer_nr; i++){
+                int v;
+                shared->pop(v);
+                seen[c].push_back(v);
+            }
+        });
+    }
+    for(auto& t : threads) t.join();
+    std::vector<int> all;
+    bool per_producer_fifo = true;
+    for(auto& part : seen){
+        std::vector<int> last(producer_nr, -1);
+        for(int v : part){
+            per_producer_fifo = per_producer_fifo && v > last[v / per_producer];
+            last[v / per_producer] = v;
+        }
+        all.insert(all.end(), part.begin(), part.end());
+    }
+    std::sort(all.begin(), all.end());
+    bool exactly_once = int(all.size()) == item_nr;
+    for(int i = 0; exactly_once && i < item_nr; i++) exactly_once = all[i] == i;
+    CHECK(exactly_once && per_producer_fifo && shared->empty());
+    delete shared;
+}
+
+// Spawns one task per level of a binary recursion into group, so tasks
+// spawn tasks from worker threads.
+void spawn_tree(TaskGroup& group, int depth, std::atomic<int>& leaves){
+    if(depth == 0){
+        leaves++;
+        return;
+    }
+    group.spawn([&group, depth, &leaves]{ spawn_tree(group, depth - 1, leaves);});
+    spawn_tree(group, depth - 1, leaves);
+}
+
+void test_work_stealing(){
+    WorkStealingDeque<int> d;
+    int v = -1;
+    CHECK(d.empty() && !d.pop(v) && !d.steal(v));
+    // Past the initial ring, so it grows while keeping its order.
+    for(int i = 0; i < 1000; i++) d.push(i);
+    CHECK(d.size() == 1000);
+    CHECK(d.steal(v) && v == 0 && d.steal(v) && v == 1);
+    CHECK(d.pop(v) && v == 999 && d.size() == 997);
+    while(d.pop(v)){}
+    CHECK(v == 2 && d.empty() && !d.steal(v));
+
+    // The owner pushes and pops while thieves steal; every value is taken
+    // by exactly one thread.
+    const int item_nr = 100000, thief_nr = 3;
+    WorkStealingDeque<int>* shared = new WorkStealingDeque<int>;
+    std::vector<std::vector<int>> taken(thief_nr + 1);
+    std::atomic<bool> done(false);
+    std::vector<std::thread> thieves;
+    for(int t = 0; t < thief_nr; t++){
+        thieves.emplace_back([=, &taken, &done]{
+            int x;
+            while(!done.load() || !shared->empty()){
+                if(shared->steal(x)) taken[t].push_back(x);
+            }
+        });
+    }
+    for(int i = 0; i < item_nr; i++){
+        shared->push(i);
+        int x;
+        if(i % 3 == 0 && shared->pop(x)) taken[thief_nr].push_back(x);
+    }
+    done = true;
+    for(auto& t : thieves) t.join();
+    int x;
+    while(shared->pop(x)) taken[thief_nr].push_back(x);
+    std::vector<int> all;
+    for(auto& part : taken) all.insert(all.end(), part.begin(), part.end());
+    std::sort(all.begin(), all.end());
+    bool exactly_once = int(all.size()) == item_nr;
+    for(int i = 0; exactly_once && i < item_nr; i++) exactly_once = all[i] == i;
+    CHECK(exactly_once);
+    delete shared;
+
+    for(size_t thread_nr : {size_t(1), size_t(4)}){
+        TaskScheduler scheduler(thread_nr);
+        CHECK(scheduler.thread_count() == thread_nr);
+
+        std::atomic<int> sum(0);
+        {
+            TaskGroup group(scheduler);
+            for(int i = 1; i <= 1000; i++) group.spawn([&sum, i]{ sum += i;});
+            group.wait();
+            CHECK(sum == 1000 * 1001 / 2);
+        }
+
+        std::atomic<int> leaves(0);
+        {
+            TaskGroup group(scheduler);
+            spawn_tree(group, 12, leaves);
+            group.wait();
+            CHECK(leaves == 1 << 12);
+        }
+
+        // The first exception is rethrown once; the group is usable after.
+        {
+            TaskGroup group(scheduler);
+            std::atomic<int> ran(0);
+            for(int i = 0; i < 200; i++){
+                group.spawn([&ran, i]{
+                    ran++;
+                    if(i == 50) throw std::runtime_error("task");
+                });
+            }
+            CHECK(throws<std::runtime_error>([&]{ group.wait();}));
+            CHECK(ran >= 1 && ran <= 200);
+            group.spawn([&ran]{ ran = -1;});
+            group.wait();
+            CHECK(ran == -1);
+        }
+
+        // A group destroyed without wait() still lets its tasks finish.
+        std::atomic<int> finished(0);
+        {
+            TaskGroup group(scheduler);
+            for(int i = 0; i < 100; i++) group.spawn([&finished]{ finished++;});
+        }
+        CHECK(finished == 100);
+
+        std::vector<int> hits(5000, 0);
+        scheduler.parallel_for(0, [&](size_t){ hits[0] = -1;});
+        scheduler.parallel_for(hits.size(), [&](size_t i){ hits[i]++;});
+        CHECK(std::count(hits.begin(), hits.end(), 1) == 5000);
+        CHECK(throws<std::out_of_range>([&]{
+            scheduler.parallel_for(1000, [](size_t i){ if(i == 777) throw std::out_of_range("777");});
+        }));
+    }
+}
+
+// Pushes, batch pushes and pops random values on a PriorityQueue and on a
+// std::priority_queue and reports whether their tops always agree.
+template <typename PQ, typename Compare>
+bool heap_matches_std(unsigned seed){
+    std::mt19937 rng(seed);
+    PQ q;
+    std::priority_queue<int, std::vector<int>, Compare> expect;
+    for(int step = 0; step < 2000; step++){
+        int op = rng() % 4;
+        if(op == 0 && !expect.empty()){
+            q.pop();
+            expect.pop();
+        }else if(op == 1){
+            // Both the small-batch sift and the rebuild.
+            std::vector<int> batch(rng() % 2 ? 3 : 300);
+            for(int& x : batch) x = rng() % 1000;
+            q.push_range(batch.begin(), batch.end());
+            for(int x : batch) expect.push(x);
+        }else{
+            int x = rng() % 1000;
+            q.push(x);
+            expect.push(x);
+        }
+        if(q.size() != expect.size() || (!q.empty() && q.top() != expect.top())) return false;
+    }
+    while(!expect.empty()){
+        if(q.top() != expect.top()) return false;
+        q.pop();
+        expect.pop();
+    }
+    return q.empty();
+}
+
+void test_priority_queue(){
+    CHECK((heap_matches_std<PriorityQueue<int>, std::less<int>>(1)));
+    CHECK((heap_matches_std<PriorityQueue<int, std::less<int>, Vector<int>, 2>, std::less<int>>(2)));
+    CHECK((heap_matches_std<PriorityQueue<int, std::greater<int>, Vector<int>, 8>, std::greater<int>>(3)));
+    CHECK((heap_matches_std<PriorityQueue<int, std::less<int>, Deque<int, NewAllocator, 64>>, std::less<int>>(4)));
+
+    std::istringstream in("5 1 9 3 7");
+    PriorityQueue<int> from_input{std::istream_iterator<int>(in), std::istream_iterator<int>()};
+    CHECK(from_input.size() == 5 && from_input.top() == 9);
+    std::vector<int> none;
+    from_input.push_range(none.begin(), none.end());
+    CHECK(from_input.size() == 5 && from_input.top() == 9);
+
+    PriorityQueue<std::string> words;
+    for(const char* w : {"pear", "apple", "quince", "fig"}) words.emplace(w);
+    words.pop();
+    CHECK(words.top() == "pear" && words.size() == 3);
+
+    // Every operation on an indexed heap, checked against a table of the
+    // queued ids' priorities.
+    std::mt19937 rng(5);
+    IndexedPriorityQueue<int, std::greater<int>> iq;
+    std::vector<int> model(200, -1);
+    bool ok = true;
+    for(int step = 0; step < 5000 && ok; step++){
+        size_t id = rng() % model.size();
+        int value = rng() % 10000;
+        bool queued = model[id] >= 0;
+        switch(rng() % 5){
+            case 0:
+                if(!queued){ iq.push(id, value); model[id] = value;}
+                break;
+            case 1:
+                if(queued){
+                    int lower = std::min(value, model[id]);
+                    iq.decrease_key(id, lower);
+                    model[id] = lower;
+                }
+                break;
+            case 2:
+                if(queued){ iq.update(id, value); model[id] = value;}
+                break;
+            case 3:
+                if(queued){ iq.erase(id); model[id] = -1;}
+                break;
+            case 4:
+                if(!iq.empty()){
+                    ok = model[iq.top_id()] == iq.top();
+                    model[iq.top_id()] = -1;
+                    iq.pop();
+                }
+                break;
+        }
+        size_t queued_nr = 0;
+        int best = -1;
+        for(size_t i = 0; i < model.size() && ok; i++){
+            if(model[i] < 0){
+                ok = !iq.contains(i);
+                continue;
+            }
+            queued_nr++;
+            ok = iq.contains(i) && iq.priority(i) == model[i];
+            if(best < 0 || model[i] < best) best = model[i];
+        }
+        ok = ok && iq.size() == queued_nr && (queued_nr == 0 || iq.top() == best);
+    }
+    CHECK(ok);
+    iq.clear();
+    CHECK(iq.empty() && !iq.contains(0));
+    iq.push(1000, 3);
+    CHECK(iq.contains(1000) && iq.top_id() == 1000);
+}
+
+// Whether ring holds exactly the values in expect, front to back, through
+// indexing, iterators and the two spans.
+template <typename RING>
+bool ring_holds(const RING& ring, std::initializer_list<int> expect){
+    if(ring.size() != expect.size()) return false;
+    if(!std::equal(ring.begin(), ring.end(), expect.begin())) return false;
+    size_t i = 0;
+    for(int x : expect) if(ring[i++] != x) return false;
+    auto first = ring.first_span(), second = ring.second_span();
+    if(first.second + second.second != ring.size()) return false;
+    return std::equal(first.first, first.first + first.second, expect.begin())
+        && std::equal(second.first, second.first + second.second, expect.begin() + first.second);
+}
+
+void test_ring_buffer(){
+    RingBuffer<int, 8> r;
+    CHECK(r.empty() && r.capacity() == 8 && r.first_span().second == 0 && r.second_span().second == 0);
+    for(int i = 0; i < 6; i++) r.push_back(i);
+    for(int i = 0; i < 4; i++) r.pop_front();
+    for(int i = 6; i < 11; i++) r.push_back(i);
+    // Slots 4..7 and 0..2 hold the elements, so they wrap.
+    CHECK(ring_holds(r, {4, 5, 6, 7, 8, 9, 10}));
+    CHECK(r.first_span().second == 4 && r.second_span().second == 3);
+    r.push_front(3);
+    CHECK(r.full() && r.front() == 3 && r.back() == 10);
+    r.pop_back();
+    r.pop_back();
+    r.push_front(2);
+    CHECK(ring_holds(r, {2, 3, 4, 5, 6, 7, 8}));
+    std::reverse(r.begin(), r.end());
+    CHECK(ring_holds(r, {8, 7, 6, 5, 4, 3, 2}));
+    std::sort(r.begin(), r.end());
+    CHECK(ring_holds(r, {2, 3, 4, 5, 6, 7, 8}));
+    CHECK(r.end() - r.begin() == 7 && r.begin() + 7 == r.end() && r.begin() < r.end());
+    const RingBuffer<int, 8>& cr = r;
+    RingBuffer<int, 8>::const_iterator it = r.begin();
+    CHECK(it[2] == 4 && *(cr.end() - 1) == 8);
+
+    Tracked::reset();
+    {
+        RingBuffer<Tracked, 4> a;
+        for(int i = 0; i < 3; i++) a.emplace_back(i);
+        a.pop_front();
+        a.emplace_back(3);
+        a.emplace_back(4);
+        RingBuffer<Tracked, 4> b(a);
+        CHECK(b.size() == 4 && b.front().value == 1 && b.back().value == 4);
+        RingBuffer<Tracked, 4> c(std::move(a));
+        // A moved-from ring is empty and usable.
+        CHECK(a.empty() && c.size() == 4 && c[3].value == 4);
+        a.emplace_front(9);
+        CHECK(a.size() == 1 && a.back().value == 9);
+        a = std::move(c);
+        CHECK(c.empty() && a.size() == 4 && a.front().value == 1);
+        a.swap(b);
+        c = b;
+        CHECK(c.size() == 4 && c[2].value == 3);
+    }
+    CHECK(Tracked::live == 0);
+
+    typedef CountingAllocator<Tracked> Alloc;
+    {
+        DynamicRingBuffer<Tracked, Alloc> d;
+        CHECK(d.capacity() == 0 && d.begin() == d.end() && Alloc::live == 0);
+        for(int i = 0; i < 16; i++) d.emplace_back(i);
+        for(int i = 0; i < 10; i++) d.pop_front();
+        for(int i = 16; i < 26; i++) d.emplace_back(i);
+        CHECK(d.full() && d.capacity() == 16 && d.second_span().second > 0);
+        // Growth from a wrapped, full ring, taking an element of the ring.
+        Tracked::reset();
+        d.push_back(d[0]);
+        d.push_front(d.back());
+        CHECK(d.capacity() == 32 && d.size() == 18 && Tracked::copies == 2);
+        CHECK(d.front().value == 10 && d.back().value == 10);
+        bool in_order = true;
+        for(size_t i = 1; i < 17; i++) in_order = in_order && d[i].value == int(i) + 9;
+        CHECK(in_order && Alloc::live == 1);
+
+        DynamicRingBuffer<Tracked, Alloc> e(std::move(d));
+        CHECK(d.empty() && d.capacity() == 0 && e.size() == 18 && Alloc::live == 1);
+        d.emplace_front(1);
+        CHECK(d.size() == 1 && d.capacity() == RING_BUFFER_MIN_CAPACITY && Alloc::live == 2);
+        d = std::move(e);
+        CHECK(d.size() == 18 && e.empty() && Alloc::live == 1);
+        d.clear();
+        d.reserve(100);
+        CHECK(d.capacity() == 128 && d.empty());
+    }
+    CHECK(Tracked::live == 0 && Alloc::live == 0);
+
+    // Relocatable elements grow by a byte copy.
+    {
+        DynamicRingBuffer<OwnsInt> d;
+        for(int i = 0; i < 100; i++) d.emplace_front(i);
+        OwnsInt::moves = 0;
+        d.reserve(1000);
+        CHECK(OwnsInt::moves == 0 && *d.front().p == 99 && *d.back().p == 0);
+    }
+
+    // A copy that throws while growing leaves the ring as it was.
+    {
+        DynamicRingBuffer<ThrowOnCopy> d;
+        for(int i = 0; i < 16; i++) d.emplace_back(i);
+        d.pop_front();
+        d.emplace_back(16);
+        ThrowOnCopy::countdown = 8;
+        CHECK(throws<std::runtime_error>([&]{ d.emplace_back(17);}));
+        ThrowOnCopy::countdown = -1;
+        bool same = d.size() == 16 && d.capacity() == 16;
+        for(int i = 0; same && i < 16; i++) same = d[i].value == i + 1;
+        CHECK(same);
+    }
+
+    // Growing moves a move-only type; a throwing move keeps the old block.
+    typedef CountingAllocator<ThrowOnMove> MoveAlloc;
+    {
+        DynamicRingBuffer<ThrowOnMove, MoveAlloc> d;
+        for(int i = 0; i < 16; i++) d.emplace_back(i);
+        d.pop_front();
+        d.emplace_back(16);
+        ThrowOnMove::countdown = 3;
+        CHECK(throws<std::runtime_error>([&]{ d.emplace_back(17);}));
+        ThrowOnMove::countdown = -1;
+        CHECK(d.size() == 16 && d.capacity() == 16 && ThrowOnMove::live == 16 && MoveAlloc::live == 1);
+        d.emplace_back(17);
+        CHECK(d.size() == 17 && d.front().value == 1 && d.back().value == 17 && MoveAlloc::live == 1);
+    }
+    CHECK(ThrowOnMove::live == 0 && MoveAlloc::live == 0);
+
+    Queue<int, RingBuffer<int, 16>> q;
+    Stack<int, DynamicRingBuffer<int>> st;
+    for(int i = 0; i < 40; i++){
+        q.push(i);
+        if(q.size() > 10) q.pop();
+        st.push(i);
+    }
+    CHECK(q.size() == 10 && q.front() == 30 && q.back() == 39);
+    CHECK(st.size() == 40 && st.top() == 39);
+}
+
 int main() {
+    test_pool_threads();
+    test_pool_stats();
+    test_chunk_source();
+    test_pool_trim();
+    test_stateful_allocators();
+    test_deque_move();
+    test_arena();
+    test_alignment();
+    test_batch_nodes();
+    test_vector_relocate();
+    test_vector_emplace();
+    test_small_vector();
+    test_vector_simd();
+    test_simd_levels();
+    test_mapped_vector();
+    test_parallel();
+    test_soa_vector();
+    test_soa_vector_rows();
+    test_vector_ranges();
+    test_deque_spare_blocks();
+    test_deque_block_size();
+    test_deque_segmented();
+    test_deque_insert_erase();
+    test_spsc_ring();
+    test_mpmc_queue();
+    test_work_stealing();
+    test_priority_queue();
+    test_ring_buffer();
+
     MultiMap<int, int> map;
     map.insert(std::make_pair(6, 5));
     map.insert(std::make_pair(2, 7));
@@ -30,6 +1828,10 @@ int main() {
     map.erase(map.upper_bound(5));
     map.show();
     cout<<map.count(6)<<endl;
+
+    List<int, PollAllocator<ListNode<int>>> pool_list;
+    for(int i = 0; i < 10; i++) pool_list.push_back(i);
+    pool_list.show();
     // RBTree<int, int, _Identity<int>> tree;
     // bool inserted = false;
     // tree.show();
@@ -150,5 +1952,5 @@ int main() {
 
     // tree.erase(tree.lower_bound(17));
     // tree.show();
-    return 0;
+    return failures == 0 ? 0 : 1;
 }
\ No newline at end of file